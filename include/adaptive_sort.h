@@ -0,0 +1,53 @@
+#ifndef ADAPTIVE_SORT_H
+#define ADAPTIVE_SORT_H
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+/**
+ * Sort a sequence which is expected to be nearly sorted already, for
+ * example the previous refresh's ordering of the same processes.
+ *
+ * The sequence is split in one pass into a sorted run and the few elements
+ * which break it. Only those are sorted before the two are merged back
+ * together, so a sequence with k elements out of place costs
+ * O(n + k log k) rather than O(n log n). When too many elements are out of
+ * place it falls back to a full sort. Nothing is allocated once the
+ * scratch space has grown, so less must be a strict total order: elements
+ * it considers equal may end up in any order.
+ * @tparam T
+ * @tparam Compare
+ * @param items the sequence to sort
+ * @param kept scratch space, reused between calls to avoid allocating
+ * @param displaced scratch space, reused between calls to avoid allocating
+ * @param less
+ */
+template <typename T, typename Compare>
+void AdaptiveSort(std::vector<T>& items, std::vector<T>& kept,
+                  std::vector<T>& displaced, Compare less) {
+  kept.clear();
+  displaced.clear();
+  std::size_t limit = items.size() / 4;
+  for (auto const& item : items) {
+    if (kept.empty() || !less(item, kept.back())) {
+      kept.push_back(item);
+    } else if (kept.size() >= 2 && !less(item, kept[kept.size() - 2])) {
+      // The last kept element is the one out of place, for example a
+      // process which has just become busy, so displace it instead
+      displaced.push_back(kept.back());
+      kept.back() = item;
+    } else {
+      displaced.push_back(item);
+    }
+    if (displaced.size() > limit) {
+      std::sort(items.begin(), items.end(), less);
+      return;
+    }
+  }
+  std::sort(displaced.begin(), displaced.end(), less);
+  std::merge(kept.begin(), kept.end(), displaced.begin(), displaced.end(),
+             items.begin(), less);
+}
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "process.h"
+
+/**
+ * A single compiled alert rule. Rules are read from a config file with one
+ * rule per line:
+ *
+ *   # name    scope    metric   op  threshold  for  action
+ *   hot_proc  process  cpu      >   90%        30s  log:/tmp/alerts.log
+ *   mem_full  system   memory   >   95%        0s   exec:/usr/local/bin/hook
+ *   run_queue system   running  >   2cores     10s  log:/tmp/alerts.log
+ *
+ * System metrics are cpu, memory, running and total. Process metrics are
+ * cpu and rss. Thresholds may be suffixed with % (hundredths), cores
+ * (multiplied by the number of online cpus) or, for rss, M or G.
+ * Durations may be suffixed with s, m or h.
+ */
+struct AlertRule {
+ public:
+  enum class Scope { kSystem, kProcess };
+  enum class Metric { kCpu, kMemory, kRunning, kTotal, kRss };
+  enum class Op { kGreater, kGreaterEqual, kLess, kLessEqual };
+
+  std::string name{};
+  Scope scope{};
+  Metric metric{};
+  Op op{};
+  double threshold{};
+  double for_seconds{};
+  std::size_t action{};
+};
+
+/**
+ * Evaluates a set of alert rules against the sampled metrics once per
+ * refresh. Each rule only keeps the time its condition became true, per
+ * process for process rules, so no history is ever re-scanned. A rule fires
+ * its action once when its condition has held for its duration and is
+ * re-armed when the condition clears.
+ */
+class AlertEngine {
+ public:
+  /**
+   * Compile the rules in the config file at path into the provided engine.
+   * Returns false and sets error if the file can not be read or a rule is
+   * invalid
+   * @param path
+   * @param engine
+   * @param error
+   * @return
+   */
+  static bool Compile(std::string const& path, AlertEngine& engine,
+                      std::string& error);
+
+  /**
+   * Does the engine have any rules?
+   * @return
+   */
+  bool Empty() const;
+
+  /**
+   * The number of rules
+   * @return
+   */
+  std::size_t Rules() const;
+
+  /**
+   * Evaluate every rule against the system metrics a refresh read and the
+   * provided processes
+   * @param cpu share of the cpus in use since the previous refresh
+   * @param memory share of memory in use
+   * @param running number of running processes
+   * @param total number of processes created since boot
+   * @param processes
+   */
+  void Evaluate(double cpu, double memory, int running, int total,
+                std::vector<Process>& processes);
+
+  /**
+   * Evaluate every rule against the provided system metrics and processes
+   * at the provided time. Used by Evaluate and by alert_engine_benchmark,
+   * which needs to control the clock and metrics
+   * @param now monotonic time in seconds
+   * @param system_values system metrics indexed by AlertRule::Metric
+   * @param processes
+   */
+  void Evaluate(double now, double const* system_values,
+                std::vector<Process>& processes);
+
+  /**
+   * The number of alerts which are currently firing
+   * @return
+   */
+  std::size_t Firing() const;
+
+ private:
+  /**
+   * Number of AlertRule::Metric values
+   */
+  static const std::size_t kMetrics = 5;
+
+  /**
+   * Where a rule's alert goes when it fires
+   */
+  struct Action {
+   public:
+    enum class Kind { kLog, kExec };
+    Kind kind{};
+    std::string target{};
+    std::unique_ptr<std::ofstream> log{};
+  };
+
+  /**
+   * State of a rule for the system or a single process
+   */
+  struct RuleState {
+   public:
+    double true_since{};
+    unsigned long last_tick{};
+    bool firing{};
+  };
+
+  /**
+   * Process rules with the same metric and direction of comparison,
+   * ordered so that the rules matching any value are a prefix of the group
+   */
+  struct ProcessGroup {
+   public:
+    AlertRule::Metric metric{};
+    bool above{};
+    std::vector<std::size_t> rules{};
+  };
+
+  /**
+   * Parse a single config line into a rule
+   * @param line
+   * @param rule
+   * @param error
+   * @return
+   */
+  bool ParseRule(std::string const& line, AlertRule& rule,
+                 std::string& error);
+
+  /**
+   * Build the evaluation plan from the parsed rules
+   */
+  void Plan();
+
+  /**
+   * Evaluate the system rules
+   * @param now
+   * @param system_values
+   */
+  void EvaluateSystem(double now, double const* system_values);
+
+  /**
+   * Evaluate the process rules
+   * @param now
+   * @param processes
+   */
+  void EvaluateProcesses(double now, std::vector<Process>& processes);
+
+  /**
+   * Does the value satisfy the rule's condition?
+   * @param rule
+   * @param value
+   * @return
+   */
+  static bool Matches(AlertRule const& rule, double value);
+
+  /**
+   * Update the state of a rule whose condition holds, firing it if it has
+   * held for long enough
+   * @param rule
+   * @param state
+   * @param now
+   * @param value
+   * @param process the process the rule matched or nullptr for system rules
+   */
+  void Hold(std::size_t rule, RuleState& state, double now, double value,
+            Process* process);
+
+  /**
+   * Run a rule's action
+   * @param rule
+   * @param value
+   * @param process
+   */
+  void Fire(AlertRule const& rule, double value, Process* process);
+
+  /**
+   * Collect any exec'd hooks which have finished
+   */
+  void ReapHooks();
+
+  std::vector<AlertRule> rules_{};
+  std::vector<Action> actions_{};
+  std::vector<std::size_t> system_rules_{};
+  std::vector<ProcessGroup> process_groups_{};
+  std::vector<RuleState> system_state_{};
+  std::vector<std::unordered_map<int, RuleState>> process_state_{};
+  unsigned long tick_{};
+  std::size_t firing_{};
+  std::size_t running_hooks_{};
+};
+
+#endif
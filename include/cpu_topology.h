@@ -0,0 +1,79 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "linux_parser.h"
+#include "process.h"
+
+/**
+ * Load on a single cpu and the processes which last ran on it
+ */
+struct CoreLoad {
+ public:
+  float utilization{};
+  std::size_t processes{};
+  float process_cpu{};
+};
+
+/**
+ * Load on a NUMA node's cpus and the processes which last ran on them
+ */
+struct NodeLoad {
+ public:
+  int id{};
+  std::vector<int> cpus{};
+  float utilization{};
+  std::size_t processes{};
+  float process_cpu{};
+};
+
+/**
+ * Class to represent where on the machine work is running: the load on
+ * each cpu and NUMA node, with processes attributed to the cpu they last ran
+ * on. Like Processor, loads are the delta between two updates of /proc/stat.
+ * The topology is read once, on construction. Without NUMA information
+ * every cpu is placed on a single node
+ */
+class CpuTopology {
+ public:
+  CpuTopology();
+
+  /**
+   * Read the load on each cpu since the previous update and attribute the
+   * processes to the cpus they last ran on
+   * @param processes
+   */
+  void Update(std::vector<Process> const& processes);
+
+  /**
+   * The NUMA nodes, ordered by id
+   * @return
+   */
+  std::vector<NodeLoad> const& Nodes() const;
+
+  /**
+   * The load on each cpu, indexed by cpu number
+   * @return
+   */
+  std::vector<CoreLoad> const& Cores() const;
+
+  /**
+   * The id of the node a cpu belongs to, or -1 if it is not known
+   * @param cpu
+   * @return
+   */
+  int NodeOf(int cpu) const;
+
+ private:
+  std::string buffer_{};
+  std::vector<LinuxParser::CPUValues> values_{};
+  std::vector<LinuxParser::CPUValues> prev_values_{};
+  std::vector<CoreLoad> cores_{};
+  std::vector<NodeLoad> nodes_{};
+  std::vector<int> node_of_cpu_{};
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef DEVICE_RATES_H
+#define DEVICE_RATES_H
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "linux_parser.h"
+
+/**
+ * Per second rates of a single network interface
+ */
+struct InterfaceRate {
+ public:
+  std::string_view name{};
+  double rx_bytes{};
+  double tx_bytes{};
+  double rx_packets{};
+  double tx_packets{};
+};
+
+/**
+ * Per second rates of a single block device. Utilization is the share of
+ * the interval in which the device had I/O in flight
+ */
+struct DiskRate {
+ public:
+  std::string_view name{};
+  double reads{};
+  double writes{};
+  double read_bytes{};
+  double write_bytes{};
+  float utilization{};
+};
+
+/**
+ * Class to represent the throughput of the system's network interfaces and
+ * block devices. Like Processor, rates are the delta between the counters
+ * of two successive updates. Counters are kept in fixed arrays which are
+ * swapped between updates, so updating reads each file once and does not
+ * allocate
+ */
+class DeviceRates {
+ public:
+  DeviceRates();
+
+  /**
+   * Read the current counters and calculate the rates since the previous
+   * update
+   */
+  void Update();
+
+  /**
+   * Fill out with the k interfaces moving the most bytes, busiest first
+   * @param k
+   * @param out
+   */
+  void TopInterfaces(std::size_t k, std::vector<InterfaceRate>& out) const;
+
+  /**
+   * Fill out with the k most utilized block devices, busiest first
+   * @param k
+   * @param out
+   */
+  void TopDisks(std::size_t k, std::vector<DiskRate>& out) const;
+
+  /**
+   * The number of network interfaces
+   * @return
+   */
+  std::size_t Interfaces() const;
+
+  /**
+   * The number of block devices
+   * @return
+   */
+  std::size_t Disks() const;
+
+  /**
+   * Number of bytes in a disk sector as counted by /proc/diskstats
+   */
+  static const long kSectorSize = 512;
+
+ private:
+  std::string buffer_{};
+  std::unique_ptr<LinuxParser::NetworkValues> network_;
+  std::unique_ptr<LinuxParser::NetworkValues> prev_network_;
+  std::unique_ptr<LinuxParser::DiskStatsValues> disks_;
+  std::unique_ptr<LinuxParser::DiskStatsValues> prev_disks_;
+  std::vector<InterfaceRate> interface_rates_{};
+  std::vector<DiskRate> disk_rates_{};
+  std::chrono::steady_clock::time_point updated_{};
+};
+
+#endif
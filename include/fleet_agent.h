@@ -0,0 +1,105 @@
+#ifndef FLEET_AGENT_H
+#define FLEET_AGENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fleet_protocol.h"
+#include "overhead_governor.h"
+#include "refresh_scheduler.h"
+#include "system.h"
+
+/**
+ * Samples the local system and streams each snapshot to a
+ * fleet aggregator as a delta from the one before.
+ *
+ * The socket never blocks, so a slow or unreachable aggregator can not
+ * stall sampling. Frames which can not be sent at once are queued, and if
+ * the queue grows past kMaxQueued the connection is dropped and the next
+ * one starts again from a full snapshot
+ */
+class FleetAgent {
+ public:
+  /**
+   * Most bytes which may wait to be sent to the aggregator
+   */
+  static const std::size_t kMaxQueued = 4 << 20;
+
+  /**
+   * Construct a new agent which sends to the aggregator at host:port
+   * @param host
+   * @param port
+   */
+  FleetAgent(std::string host, int port);
+
+  FleetAgent(FleetAgent const&) = delete;
+  FleetAgent& operator=(FleetAgent const&) = delete;
+  ~FleetAgent();
+
+  /**
+   * Sample and send until a shutdown is requested, refreshing whenever the
+   * scheduler says to and keeping within the governor's budget
+   * @param system
+   * @param refresh
+   * @param governor
+   */
+  void Run(System& system, RefreshScheduler& refresh,
+           OverheadGovernor& governor);
+
+  /**
+   * Sample the system and queue a single snapshot, connecting first if
+   * needed, then send as much of the queue as the socket will take.
+   * Returns false if there is no connection to send the snapshot on
+   * @param system
+   * @return
+   */
+  bool Send(System& system);
+
+  /**
+   * Number of bytes waiting to be sent
+   * @return
+   */
+  std::size_t Queued() const;
+
+ private:
+  /**
+   * Start connecting to the aggregator and queue a hello frame
+   * @return
+   */
+  bool Connect();
+
+  /**
+   * Send as much of out_ as the socket will take without blocking. Returns
+   * false, dropping the connection, if it has failed
+   * @return
+   */
+  bool Flush();
+
+  /**
+   * Drop the connection so the next send reconnects
+   */
+  void Disconnect();
+
+  std::string host_;
+  int port_;
+  int fd_{-1};
+
+  /**
+   * Has anything been sent on the current connection? If not when it is
+   * dropped, the next connection tries the aggregator's next address
+   */
+  bool established_{false};
+  std::size_t next_address_{};
+
+  FleetProtocol::Encoder encoder_{};
+
+  /**
+   * Frames waiting to be sent, from out_sent_ on
+   */
+  std::vector<std::uint8_t> out_{};
+  std::size_t out_sent_{};
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef FLEET_AGGREGATOR_H
+#define FLEET_AGGREGATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fleet_protocol.h"
+#include "string_pool.h"
+
+/**
+ * A process on a fleet host as last reported by its agent
+ */
+struct FleetProcess {
+ public:
+  int pid{};
+  StringPool::Id user{};
+  StringPool::Id command{};
+  long vm_size{};
+  long vm_rss{};
+  long utime_ticks{};
+  long stime_ticks{};
+  long starttime_ticks{};
+  std::int64_t cpu{};
+};
+
+/**
+ * The state of a single host, rebuilt from the frames its agent sends
+ */
+class FleetHost {
+ public:
+  /**
+   * Number of each host's busiest processes kept for the fleet view
+   */
+  static constexpr std::size_t kTopProcesses = 64;
+
+  /**
+   * Apply a snapshot frame to the host. Returns false if the frame is
+   * malformed, in which case the host's state is undefined
+   * @param reader
+   * @param strings
+   * @return
+   */
+  bool Apply(FleetProtocol::FrameReader& reader, StringPool& strings);
+
+  /**
+   * Move the host's strings into a new pool. Used when compacting the
+   * aggregator's string pool
+   * @param from
+   * @param to
+   */
+  void Reintern(StringPool const& from, StringPool& to);
+
+  /**
+   * The host's busiest processes, busiest first
+   * @return
+   */
+  std::vector<FleetProcess const*> const& Top() const;
+
+  std::string name{};
+  long clock_ticks{100};
+  FleetProtocol::SystemValues system{};
+  std::vector<FleetProcess> processes{};
+
+ private:
+  /**
+   * Read the fields selected by mask into process
+   * @param reader
+   * @param mask
+   * @param strings
+   * @param process
+   */
+  static void Fields(FleetProtocol::FrameReader& reader, std::uint8_t mask,
+                     StringPool& strings, FleetProcess& process);
+
+  /**
+   * Pick out the busiest processes
+   */
+  void UpdateTop();
+
+  std::vector<FleetProcess> next_{};
+  std::vector<int> exited_{};
+  std::vector<FleetProcess const*> top_{};
+};
+
+/**
+ * Accepts connections from fleet agents, merges their snapshot streams and
+ * serves a fleet wide view of the busiest processes
+ */
+class FleetAggregator {
+ public:
+  /**
+   * A process and the host it runs on
+   */
+  struct Entry {
+   public:
+    FleetHost const* host{};
+    FleetProcess const* process{};
+  };
+
+  FleetAggregator() = default;
+  FleetAggregator(FleetAggregator const&) = delete;
+  FleetAggregator& operator=(FleetAggregator const&) = delete;
+  ~FleetAggregator();
+
+  /**
+   * Start listening for agents on the provided port. Returns false and
+   * sets error if the port can not be bound
+   * @param port
+   * @param error
+   * @return
+   */
+  bool Listen(int port, std::string& error);
+
+  /**
+   * Accept agents and apply the frames they send until timeout_ms has
+   * passed, input_fd, if given, becomes readable or a signal arrives.
+   * Returns true if it stopped early for input
+   * @param timeout_ms
+   * @param input_fd
+   * @return
+   */
+  bool Pump(int timeout_ms, int input_fd = -1);
+
+  /**
+   * Fill out with the busiest n processes across the fleet, busiest first
+   * @param n
+   * @param out
+   */
+  void Top(std::size_t n, std::vector<Entry>& out) const;
+
+  /**
+   * The number of connected hosts
+   * @return
+   */
+  std::size_t Hosts() const;
+
+  /**
+   * The number of processes across all connected hosts
+   * @return
+   */
+  std::size_t Processes() const;
+
+  /**
+   * The pool host strings are interned in
+   * @return
+   */
+  StringPool const& Strings() const;
+
+  /**
+   * Number of snapshots applied since the last call to ResetCounters
+   * @return
+   */
+  std::size_t Snapshots() const;
+
+  /**
+   * Number of bytes received since the last call to ResetCounters
+   * @return
+   */
+  std::size_t Bytes() const;
+
+  /**
+   * Reset the snapshot and byte counters
+   */
+  void ResetCounters();
+
+ private:
+  /**
+   * A connected agent
+   */
+  struct Connection {
+   public:
+    int fd{-1};
+    std::vector<std::uint8_t> buffer{};
+    std::size_t consumed{};
+    std::unique_ptr<FleetHost> host{};
+  };
+
+  /**
+   * Accept every pending connection
+   */
+  void Accept();
+
+  /**
+   * Read everything available from a connection and apply every complete
+   * frame. Returns false if the connection should be closed
+   * @param connection
+   * @return
+   */
+  bool Receive(Connection& connection);
+
+  /**
+   * Apply a single frame. Returns false if it is malformed
+   * @param connection
+   * @param payload
+   * @param size
+   * @return
+   */
+  bool Apply(Connection& connection, std::uint8_t const* payload,
+             std::size_t size);
+
+  /**
+   * Rebuild the string pool from the connected hosts once strings from
+   * exited processes make up most of it
+   */
+  void CompactStrings();
+
+  int listen_fd_{-1};
+  std::vector<Connection> connections_{};
+  StringPool strings_{};
+  std::size_t snapshots_{};
+  std::size_t bytes_{};
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef FLEET_PROTOCOL_H
+#define FLEET_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "linux_parser.h"
+#include "process.h"
+#include "string_pool.h"
+
+/**
+ * Binary protocol spoken between fleet agents and the aggregator.
+ *
+ * Every frame is a 4 byte little endian payload length followed by the
+ * payload. The first payload byte is the frame type. Integers are LEB128
+ * varints and values which may shrink are zigzag encoded deltas.
+ *
+ * Hello:    type, host name, clock ticks per second
+ * Snapshot: type, uptime (centiseconds), cpu and memory utilization (parts
+ *           per 10000), running and total processes, then three pid
+ *           ordered sections, each pid delta coded from the one before:
+ *           exited pids; new processes with every field; changed processes
+ *           with a field mask followed by only the fields in the mask
+ */
+namespace FleetProtocol {
+
+const std::uint8_t kHello = 'H';
+const std::uint8_t kSnapshot = 'S';
+
+/**
+ * Size of the length prefix of a frame
+ */
+const std::size_t kHeaderSize = 4;
+
+/**
+ * Largest payload a receiver will accept
+ */
+const std::size_t kMaxPayload = 64 << 20;
+
+/**
+ * Fixed point scale used for utilization values
+ */
+const double kUtilizationScale = 10000.0;
+
+/**
+ * Bits of the changed process field mask
+ */
+enum FieldBits : std::uint8_t {
+  kUserBit = 1 << 0,
+  kCommandBit = 1 << 1,
+  kVmSizeBit = 1 << 2,
+  kVmRssBit = 1 << 3,
+  kUtimeBit = 1 << 4,
+  kStimeBit = 1 << 5,
+  kStartTimeBit = 1 << 6,
+  kCpuBit = 1 << 7,
+};
+
+/**
+ * System wide values sent with every snapshot
+ */
+struct SystemValues {
+ public:
+  double uptime{};
+  float cpu{};
+  float memory{};
+  long running{};
+  long total{};
+};
+
+/**
+ * Appends encoded values to a byte buffer
+ */
+class FrameWriter {
+ public:
+  explicit FrameWriter(std::vector<std::uint8_t>& out);
+
+  /**
+   * Start a new frame of the provided type
+   * @param type
+   */
+  void Begin(std::uint8_t type);
+
+  /**
+   * Finish the current frame by filling in its length
+   */
+  void End();
+
+  void Byte(std::uint8_t value);
+  void Varint(std::uint64_t value);
+  void Signed(std::int64_t value);
+  void Bytes(std::string_view value);
+
+ private:
+  std::vector<std::uint8_t>& out_;
+  std::size_t frame_start_{};
+};
+
+/**
+ * Reads encoded values from a frame payload. Reading past the end of the
+ * payload or a malformed value leaves the reader failed and returns zeros
+ */
+class FrameReader {
+ public:
+  FrameReader(std::uint8_t const* data, std::size_t size);
+
+  std::uint8_t Byte();
+  std::uint64_t Varint();
+  std::int64_t Signed();
+  std::string_view Bytes();
+
+  /**
+   * Has every read so far succeeded?
+   * @return
+   */
+  bool Ok() const;
+
+  /**
+   * Has the whole payload been read?
+   * @return
+   */
+  bool Done() const;
+
+ private:
+  std::uint8_t const* data_;
+  std::uint8_t const* end_;
+  bool ok_{true};
+};
+
+/**
+ * Encodes successive snapshots of a System as deltas from the
+ * previously sent snapshot
+ */
+class Encoder {
+ public:
+  /**
+   * Append a hello frame to out
+   * @param host
+   * @param out
+   */
+  void Hello(std::string const& host, std::vector<std::uint8_t>& out) const;
+
+  /**
+   * Append a snapshot frame holding everything which has changed since the
+   * previous snapshot to out
+   * @param system
+   * @param processes
+   * @param strings the pool the processes' strings are interned in
+   * @param out
+   */
+  void Snapshot(SystemValues const& system,
+                std::vector<Process> const& processes,
+                StringPool const& strings, std::vector<std::uint8_t>& out);
+
+  /**
+   * Forget what has been sent so that the next snapshot is a full one.
+   * Used after reconnecting
+   */
+  void Reset();
+
+ private:
+  /**
+   * Process fields as last sent
+   */
+  struct Sent {
+   public:
+    LinuxParser::ProcessValues values{};
+    std::int64_t cpu{};
+  };
+
+  /**
+   * A process which has changed since it was last sent
+   */
+  struct Changed {
+   public:
+    std::size_t current{};
+    std::size_t previous{};
+    std::uint8_t mask{};
+  };
+
+  /**
+   * The mask of fields which differ between two sends of a process
+   * @param current
+   * @param previous
+   * @param renumbered have the strings been renumbered, by compacting
+   * their pool, since previous was sent?
+   * @return
+   */
+  static std::uint8_t Mask(Sent const& current, Sent const& previous,
+                           bool renumbered);
+
+  /**
+   * Append the fields of a process selected by mask to the frame
+   * @param writer
+   * @param mask
+   * @param current
+   * @param previous
+   * @param strings
+   */
+  static void Fields(FrameWriter& writer, std::uint8_t mask,
+                     Sent const& current, Sent const& previous,
+                     StringPool const& strings);
+
+  std::vector<Sent> sent_{};
+
+  /**
+   * Generation of the pool the strings of sent_ were interned in
+   */
+  std::uint64_t sent_generation_{};
+
+  std::vector<Sent> current_{};
+  std::vector<int> exited_{};
+  std::vector<std::size_t> born_{};
+  std::vector<Changed> changed_{};
+};
+
+}  // namespace FleetProtocol
+
+#endif
@@ -10,6 +10,14 @@ namespace Format {
  * @return
  */
 std::string ElapsedTime(long times);
+
+/**
+ * Formats the provided number of bytes with a binary unit suffix, for
+ * example 1.5K or 12.0M
+ * @param bytes
+ * @return
+ */
+std::string Bytes(double bytes);
 };  // namespace Format
 
 #endif
\ No newline at end of file
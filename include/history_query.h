@@ -0,0 +1,47 @@
+#ifndef HISTORY_QUERY_H
+#define HISTORY_QUERY_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+#include "history_store.h"
+
+/**
+ * Answers time range queries against a history store from the command line
+ */
+namespace HistoryQuery {
+
+/**
+ * Parse a time given as "now", a number of seconds since the epoch, a
+ * relative time such as -90s, -15m, -2h or -1d, or a local date and time
+ * such as 2024-05-01T14:00 or "2024-05-01 14:00:30". Returns false if the
+ * time is not understood
+ * @param text
+ * @param now
+ * @param time
+ * @return
+ */
+bool ParseTime(std::string const& text, long now, long& time);
+
+/**
+ * Print the rows of the store in directory with buckets starting in
+ * [from, to) to out, followed by a summary of the whole range. tier is a
+ * tier name, or empty to pick one for the range. Returns false and sets
+ * error if the query can not be answered
+ * @param directory
+ * @param from
+ * @param to
+ * @param tier
+ * @param top number of processes to print for each row
+ * @param out
+ * @param error
+ * @return
+ */
+bool Run(std::string const& directory, std::string const& from,
+         std::string const& to, std::string const& tier, std::size_t top,
+         std::ostream& out, std::string& error);
+
+};  // namespace HistoryQuery
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "process.h"
+#include "string_pool.h"
+
+/**
+ * System wide metrics kept in the history store
+ */
+enum class HistoryMetric { kCpu = 0, kMemory, kRunning, kProcesses };
+
+/**
+ * Number of HistoryMetric values
+ */
+const std::size_t kHistoryMetrics = 4;
+
+/**
+ * The smallest, largest and average value of a metric over a bucket
+ */
+struct MetricSummary {
+ public:
+  double min{};
+  double max{};
+  double avg{};
+};
+
+/**
+ * One of the busiest processes of a bucket. cpu is averaged over the whole
+ * bucket, counting samples the process was not among the busiest as 0
+ */
+struct TopProcess {
+ public:
+  int pid{};
+  std::string user{};
+  std::string command{};
+  double cpu{};
+  long rss_kb{};
+};
+
+/**
+ * The metrics of a bucket of time
+ */
+struct HistoryRow {
+ public:
+  /**
+   * Start of the bucket, in seconds since the epoch
+   */
+  long time{};
+
+  /**
+   * Number of refreshes rolled up into the bucket
+   */
+  long samples{};
+
+  std::array<MetricSummary, kHistoryMetrics> metrics{};
+
+  /**
+   * The busiest processes, busiest first
+   */
+  std::vector<TopProcess> top{};
+};
+
+/**
+ * An embedded store of system history at three resolutions.
+ *
+ * Every refresh is rolled up into a 1 second bucket, each completed 1 second
+ * bucket into a 1 minute bucket and each completed minute into an hour. A
+ * bucket keeps the min, max and average of every metric and the kTopK
+ * busiest processes.
+ *
+ * Each tier is a directory of segment files, each covering kSegmentSpans of
+ * time and named by its start. Completed buckets are appended to the
+ * current segment in blocks of up to kBlockRows, written at least once a
+ * minute. A block is a length prefixed
+ * frame, in the FleetProtocol encoding, holding its rows column by column
+ * with every column delta coded as zigzag varints and commands and users
+ * in a dictionary. Alongside each segment is an index of the first and last
+ * bucket time, offset and size of each of its blocks, so a query only reads
+ * the blocks it needs. Segments older than a tier's retention are deleted,
+ * so disk usage is bounded however long the store runs
+ */
+class HistoryStore {
+ public:
+  static constexpr std::size_t kTiers = 3;
+
+  /**
+   * Bucket length of each tier, in seconds
+   */
+  static constexpr long kResolutions[kTiers] = {1, 60, 3600};
+
+  /**
+   * Directory name of each tier
+   */
+  static constexpr char const* kTierNames[kTiers] = {"1s", "1m", "1h"};
+
+  /**
+   * Time covered by each segment file of a tier, in seconds
+   */
+  static constexpr long kSegmentSpans[kTiers] = {3600, 86400, 30 * 86400};
+
+  /**
+   * How long each tier is kept, in seconds
+   */
+  static constexpr long kRetentions[kTiers] = {2 * 86400, 60 * 86400,
+                                               730 * 86400};
+
+  /**
+   * Most rows of each tier written as a single block
+   */
+  static constexpr std::size_t kBlockRows[kTiers] = {60, 60, 24};
+
+  /**
+   * Processes kept per bucket
+   */
+  static constexpr std::size_t kTopK = 10;
+
+  /**
+   * Longest command kept for a process. Command lines can be many KB
+   */
+  static constexpr std::size_t kCommandLength = 256;
+
+  /**
+   * Most rows a query picks a tier for by default
+   */
+  static constexpr long kMaxQueryRows = 1440;
+
+  HistoryStore() = default;
+  HistoryStore(HistoryStore const&) = delete;
+  HistoryStore& operator=(HistoryStore const&) = delete;
+  ~HistoryStore();
+
+  /**
+   * Start recording into the store in directory, creating it if needed.
+   * Returns false and sets error if it can not be created
+   * @param directory
+   * @param error
+   * @return
+   */
+  bool Open(std::string const& directory, std::string& error);
+
+  bool IsOpen() const;
+
+  /**
+   * Write out every bucket, including incomplete ones, and stop recording
+   */
+  void Close();
+
+  /**
+   * Record a refresh of the system, with the system wide values the
+   * refresh read
+   * @param cpu share of the cpus in use since the previous refresh
+   * @param memory share of memory in use
+   * @param running number of running processes
+   * @param processes
+   * @param strings the pool the processes' strings are interned in
+   */
+  void Record(double cpu, double memory, int running,
+              std::vector<Process> const& processes,
+              StringPool const& strings);
+
+  /**
+   * Roll up a single sample, a row with one sample, at its time. Samples
+   * must be added in time order
+   * @param sample
+   */
+  void Add(HistoryRow const& sample);
+
+  /**
+   * Read the rows of a tier with buckets starting in [from, to) from the
+   * store in directory, in time order. Rows written more than once for
+   * the same bucket, by a restarted monitor, are merged. Returns false and
+   * sets error if the store can not be read
+   * @param directory
+   * @param tier
+   * @param from
+   * @param to
+   * @param rows
+   * @param error
+   * @return
+   */
+  static bool Query(std::string const& directory, std::size_t tier,
+                    long from, long to, std::vector<HistoryRow>& rows,
+                    std::string& error);
+
+  /**
+   * The finest tier which still holds from and answers [from, to) in at
+   * most kMaxQueryRows rows
+   * @param from
+   * @param to
+   * @param now
+   * @return
+   */
+  static std::size_t TierFor(long from, long to, long now);
+
+  /**
+   * Roll row up into bucket. Call Finish once everything has been merged
+   * @param row
+   * @param bucket
+   */
+  static void Merge(HistoryRow const& row, HistoryRow& bucket);
+
+  /**
+   * Trim a merged bucket's processes to the kTopK busiest, busiest first
+   * @param bucket
+   */
+  static void Finish(HistoryRow& bucket);
+
+ private:
+  /**
+   * Rows of a tier waiting to be written and the bucket being filled
+   */
+  struct Tier {
+   public:
+    HistoryRow bucket{};
+    std::vector<HistoryRow> pending{};
+    long segment{-1};
+  };
+
+  /**
+   * Complete the bucket of a tier, passing it up to the next tier
+   * @param tier
+   */
+  void Complete(std::size_t tier);
+
+  /**
+   * Write the pending rows of a tier as a block of its segment
+   * @param tier
+   */
+  void Flush(std::size_t tier);
+
+  /**
+   * Delete the segments of a tier which have passed its retention
+   * @param tier
+   * @param now
+   */
+  void Expire(std::size_t tier, long now) const;
+
+  std::string directory_{};
+  std::array<Tier, kTiers> tiers_{};
+  // Start of the minute whose boundary last flushed every tier
+  long flushed_{-1};
+  std::vector<Process const*> busiest_{};
+  std::vector<std::uint8_t> out_{};
+};
+
+#endif
@@ -1,10 +1,18 @@
 #ifndef SYSTEM_PARSER_H
 #define SYSTEM_PARSER_H
 
+#include <array>
+#include <cstddef>
 #include <fstream>
 #include <map>
+#include <memory_resource>
 #include <regex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "string_pool.h"
 
 namespace LinuxParser {
 
@@ -20,6 +28,16 @@ const std::string kMeminfoFilename{"/meminfo"};
 const std::string kVersionFilename{"/version"};
 const std::string kOSPath{"/etc/os-release"};
 const std::string kPasswordPath{"/etc/passwd"};
+const std::string kPressureDirectory{"/proc/pressure/"};
+const std::string kCpuPressureFilename{"cpu"};
+const std::string kMemoryPressureFilename{"memory"};
+const std::string kIoPressureFilename{"io"};
+const std::string kNetDevPath{"/proc/net/dev"};
+const std::string kDiskStatsPath{"/proc/diskstats"};
+const std::string kSelfStatmPath{"/proc/self/statm"};
+const std::string kNodeDirectory{"/sys/devices/system/node/"};
+const std::string kCpuListFilename{"/cpulist"};
+const std::string kNumaMapsFilename{"/numa_maps"};
 
 /**
  * Proc file key constants
@@ -42,12 +60,131 @@ struct MemoryValues {
  */
 void MemoryUtilization(MemoryValues &values);
 
+/**
+ * Container for one line of a pressure stall information file. Averages are
+ * percentages of wall time in which some (or all) tasks were stalled
+ */
+struct StallValues {
+ public:
+  float avg10{};
+  float avg60{};
+  float avg300{};
+  long total_us{};
+};
+
+/**
+ * Container for the values of a single /proc/pressure file
+ */
+struct PressureValues {
+ public:
+  StallValues some{};
+  StallValues full{};
+};
+
+/**
+ * Fills out the provided PressureValues with values parsed from the named
+ * file in /proc/pressure. Returns false if the kernel does not provide it
+ * @param filename
+ * @param values
+ * @return
+ */
+bool Pressure(const std::string &filename, PressureValues &values);
+
+/**
+ * Largest number of devices of each kind parsed. Any more are ignored
+ */
+const std::size_t kMaxDevices{1024};
+
+/**
+ * Longest device name kept, including the terminating nul
+ */
+const std::size_t kDeviceNameSize{32};
+
+/**
+ * Container for the counters of a single network interface
+ */
+struct InterfaceValues {
+ public:
+  char name[kDeviceNameSize]{};
+  long rx_bytes{};
+  long rx_packets{};
+  long tx_bytes{};
+  long tx_packets{};
+};
+
+/**
+ * Container for the counters of every network interface, in the order
+ * /proc/net/dev lists them
+ */
+struct NetworkValues {
+ public:
+  std::size_t count{};
+  std::array<InterfaceValues, kMaxDevices> interfaces{};
+};
+
+/**
+ * Fills out the provided NetworkValues with a single read of /proc/net/dev.
+ * The buffer keeps its capacity between calls so that steady state reads
+ * do not allocate
+ * @param buffer
+ * @param values
+ * @return
+ */
+bool NetworkDevices(std::string &buffer, NetworkValues &values);
+
+/**
+ * Container for the counters of a single block device
+ */
+struct DiskValues {
+ public:
+  char name[kDeviceNameSize]{};
+  long reads{};
+  long sectors_read{};
+  long writes{};
+  long sectors_written{};
+  long io_ms{};
+};
+
+/**
+ * Container for the counters of every block device, in the order
+ * /proc/diskstats lists them
+ */
+struct DiskStatsValues {
+ public:
+  std::size_t count{};
+  std::array<DiskValues, kMaxDevices> disks{};
+};
+
+/**
+ * Fills out the provided DiskStatsValues with a single read of
+ * /proc/diskstats. The buffer keeps its capacity between calls so that
+ * steady state reads do not allocate
+ * @param buffer
+ * @param values
+ * @return
+ */
+bool DiskStats(std::string &buffer, DiskStatsValues &values);
+
+/**
+ * Read and return the resident set size of this process in KB, from
+ * /proc/self/statm
+ * @return
+ */
+long SelfResidentKb();
+
 /**
  * Read and return the system uptime
  * @return
  */
 long UpTime();
 
+/**
+ * Read and return the system uptime with the sub-second precision
+ * /proc/uptime provides
+ * @return
+ */
+double PreciseUpTime();
+
 /**
  * Return a vector of integers, one for each running process
  * @return
@@ -101,6 +238,78 @@ struct CPUValues {
  */
 void CpuUtilization(CPUValues &values);
 
+/**
+ * Fills out the provided vector with the values of each cpu from a single
+ * read of /proc/stat, indexed by cpu number. Offline cpus are left zeroed
+ * @param buffer
+ * @param values
+ */
+void CoreUtilizations(std::string &buffer, std::vector<CPUValues> &values);
+
+/**
+ * System wide values sampled on every refresh
+ */
+struct LoadValues {
+ public:
+  CPUValues cpu{};
+  MemoryValues memory{};
+  int running{};
+  int total{};
+};
+
+/**
+ * Fills out the provided LoadValues from a single read each of /proc/stat
+ * and /proc/meminfo, through buffer so that nothing is allocated once it
+ * has grown
+ * @param buffer
+ * @param values
+ */
+void Load(std::string &buffer, LoadValues &values);
+
+/**
+ * Append the cpus of a cpu list such as "0-3,8,10-11" to cpus
+ * @param list
+ * @param cpus
+ */
+void ParseCpuList(std::string_view list, std::vector<int> &cpus);
+
+/**
+ * Container for a NUMA node and the cpus which belong to it
+ */
+struct NumaNodeValues {
+ public:
+  int id{};
+  std::vector<int> cpus{};
+};
+
+/**
+ * Fills out the provided vector with the NUMA nodes listed in
+ * /sys/devices/system/node, ordered by id. Left empty if the kernel does not
+ * provide them
+ * @param nodes
+ */
+void NumaNodes(std::vector<NumaNodeValues> &nodes);
+
+/**
+ * Container for where a process may run and where its memory lives
+ */
+struct PlacementValues {
+ public:
+  std::string cpus_allowed{};
+  std::vector<long> node_kb{};
+};
+
+/**
+ * Fills out the provided PlacementValues from the Cpus_allowed_list of a
+ * process and its numa_maps, with node_kb indexed by node id. Reading
+ * numa_maps walks every mapping of the process, so this is only meant for
+ * a selected process. Returns false if the process has exited
+ * @param pid
+ * @param values
+ * @return
+ */
+bool ProcessPlacement(int pid, PlacementValues &values);
+
 /**
  * Enum of offsets of parts of the /etc/passwd file
  */
@@ -115,25 +324,123 @@ enum PasswdParts {
 };
 
 /**
- * Container for process values returned by the parser
+ * Container for process values returned by the parser.
+ * Strings are interned in the StringPool of the ProcessParseContext used to
+ * parse them
  */
 struct ProcessValues {
  public:
   int pid{};
-  std::string user_id{};
-  std::string user{};
+  long user_id{-1};
+  StringPool::Id user{};
   long vm_size{};
-  long utime_ticks;
-  long stime_ticks;
-  long starttime_ticks;
-  std::string command{};
+  long vm_rss{};
+  long utime_ticks{};
+  long stime_ticks{};
+  long starttime_ticks{};
+  int processor{-1};
+  StringPool::Id command{};
+};
+
+/**
+ * State kept between calls to ProcessValuesList so that strings are
+ * interned once and buffers are reused rather than re-allocated on
+ * every refresh
+ */
+struct ProcessParseContext {
+ public:
+  StringPool strings{};
+  std::unordered_map<long, StringPool::Id> user_by_uid{};
+  long passwd_mtime_ns{-1};
+  std::string path{};
+  std::string buffer{};
+  /**
+   * Read each process's status file, which gives its user and memory use
+   */
+  bool read_status{true};
+
+  /**
+   * Read each process's command line. Without them commands are the name
+   * from the stat file
+   */
+  bool read_command_lines{true};
+
+  /**
+   * Only the cpu and start times are wanted, as for a SampleScheduler
+   * probe, so leave the user and command unset rather than interning them
+   */
+  bool probe{false};
 };
 
 /**
  * Create a vector of filled out process values. One for each process.
+ * The vector is allocated from the provided scratch memory resource.
+ * @param context
+ * @param scratch
  * @return
  */
-std::vector<ProcessValues> ProcessValuesList();
+std::pmr::vector<ProcessValues> ProcessValuesList(
+    ProcessParseContext &context, std::pmr::memory_resource *scratch);
+
+/**
+ * Fill out the provided ProcessValues for a single process, reading only
+ * the files the context asks for.
+ * Returns false if the process has exited
+ * @param context
+ * @param pid
+ * @param values
+ * @return
+ */
+bool ReadProcessValues(ProcessParseContext &context, int pid,
+                       ProcessValues &values);
+
+/**
+ * Set path to the path of the named file in the proc directory of a process
+ * @param path
+ * @param pid
+ * @param filename
+ */
+void ProcPath(std::string &path, int pid, const std::string &filename);
+
+/**
+ * The contents of the files a single process is read from, for readers
+ * which read many processes' files before parsing any of them
+ */
+struct ProcessFiles {
+ public:
+  std::string_view status{};
+  std::string_view stat{};
+  std::string_view cmdline{};
+};
+
+/**
+ * Fill out the provided ProcessValues from the contents of a process's
+ * files, exactly as ReadProcessValues would have from reading them. Files
+ * the context does not ask for are ignored
+ * @param context
+ * @param pid
+ * @param files
+ * @param values
+ */
+void ParseProcessValues(ProcessParseContext &context, int pid,
+                        ProcessFiles const &files, ProcessValues &values);
+
+/**
+ * Re-read /etc/passwd into the context's user name cache if it has
+ * changed since it was last read
+ * @param context
+ */
+void RefreshUserNames(ProcessParseContext &context);
+
+/**
+ * Fill out the provided vector with the id of every running process.
+ * /proc is listed with getdents64 into a buffer allocated from the vector's
+ * memory resource. The kernel lists pids in ascending order
+ * @param pids
+ * @param directory the directory listed, which is only changed by tests
+ */
+void Pids(std::pmr::vector<int> &pids,
+          std::string const &directory = kProcDirectory);
 
 /**
  * Return a map of user names indexed by user id
@@ -3,14 +3,65 @@
 
 #include <curses.h>
 
+#include "fleet_aggregator.h"
+#include "overhead_governor.h"
 #include "process.h"
+#include "refresh_scheduler.h"
+#include "process_history.h"
 #include "system.h"
 
 namespace NCursesDisplay {
-void Display(System& system, int n = 10);
-void DisplaySystem(System& system, WINDOW* window);
-void DisplayProcesses(std::vector<Process>& processes, WINDOW* window, int n);
+
+/**
+ * Scroll position and selection of the process list. The selection follows
+ * its process when the list is reordered
+ */
+struct ProcessListView {
+ public:
+  std::size_t top{};
+  std::size_t selected{};
+  int selected_pid{-1};
+  double frame_ms{};
+};
+
+/**
+ * The devices shown on the device panel. Kept between frames so drawing it
+ * reuses the same buffers
+ */
+struct DeviceRows {
+ public:
+  std::vector<InterfaceRate> interfaces{};
+  std::vector<DiskRate> disks{};
+};
+
+void Display(System& system, RefreshScheduler& scheduler,
+             OverheadGovernor& governor);
+void DisplaySystem(System& system, RefreshScheduler const& scheduler,
+                   OverheadGovernor const& governor, WINDOW* window);
+void DisplayDevices(DeviceRates const& devices, DeviceRows& rows,
+                    WINDOW* window);
+void DisplayTopology(CpuTopology const& topology, Process const* selected,
+                     LinuxParser::PlacementValues const& placement,
+                     WINDOW* window);
+void DisplayProcesses(std::vector<Process>& processes,
+                      ProcessHistory const& history, ProcessSort sort,
+                      ProcessListView& view, WINDOW* window);
+
+/**
+ * Apply a key press to the process list. Returns false if the key asks to
+ * quit
+ * @param key
+ * @param system
+ * @param view
+ * @param rows the number of process rows on screen
+ * @return
+ */
+bool HandleKey(int key, System& system, ProcessListView& view, int rows);
 std::string ProgressBar(float percent);
+void DisplayFleet(FleetAggregator& aggregator, int n = 10);
+void DisplayFleetSummary(FleetAggregator& aggregator, double seconds,
+                         WINDOW* window);
+void DisplayFleetProcesses(FleetAggregator& aggregator, WINDOW* window, int n);
 };  // namespace NCursesDisplay
 
 #endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Command line options
+ */
+struct Options {
+ public:
+  /**
+   * Processes using at least this much cpu, where 1.0 is one full core,
+   * are read on every refresh
+   */
+  float cpu_floor{0.005f};
+
+  /**
+   * Path of the alert rules config file. No alerts if empty
+   */
+  std::string alerts{};
+
+  /**
+   * Refresh interval in milliseconds while the system is under pressure
+   */
+  int fast_interval_ms{250};
+
+  /**
+   * Longest refresh interval in milliseconds while the system is calm
+   */
+  int calm_interval_ms{4000};
+
+  /**
+   * Run as a fleet agent sending to the aggregator on this host
+   */
+  std::string agent_host{};
+
+  /**
+   * Port of the aggregator an agent sends to
+   */
+  int agent_port{};
+
+  /**
+   * Run as a fleet aggregator listening on this port. 0 if not aggregating
+   */
+  int aggregate_port{};
+
+  /**
+   * Most of a core, in percent, the monitor may use itself before it
+   * degrades its sampling. 0 for no budget
+   */
+  float cpu_budget{};
+
+  /**
+   * Most resident memory, in MB, the monitor may use itself before it
+   * degrades its sampling. 0 for no budget
+   */
+  long memory_budget_mb{};
+
+  /**
+   * Read process files with batched io_uring operations rather than
+   * one system call at a time
+   */
+  bool io_uring{};
+
+  /**
+   * Record every refresh into the history store in this directory. No
+   * history if empty
+   */
+  std::string history{};
+
+  /**
+   * Answer a query against the history store in this directory instead of
+   * monitoring. Not querying if empty
+   */
+  std::string query{};
+
+  /**
+   * Start and end of the queried range, in any form HistoryQuery::ParseTime
+   * accepts
+   */
+  std::string query_from{"-1h"};
+  std::string query_to{"now"};
+
+  /**
+   * Tier to query, or empty to pick one for the range
+   */
+  std::string query_tier{};
+
+  /**
+   * Processes to print for each queried row
+   */
+  std::size_t query_top{5};
+
+  /**
+   * Parse the provided command line into options. Prints a usage message
+   * to stderr and returns false if the command line is invalid
+   * @param argc
+   * @param argv
+   * @param options
+   * @return
+   */
+  static bool Parse(int argc, char* argv[], Options& options);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef OVERHEAD_GOVERNOR_H
+#define OVERHEAD_GOVERNOR_H
+
+#include <chrono>
+#include <cstddef>
+
+#include "refresh_scheduler.h"
+#include "system.h"
+
+/**
+ * Measures what the monitor itself costs and keeps it within a budget.
+ * After every refresh the cpu time the process has used since the previous
+ * refresh is measured with getrusage and its resident memory is read from
+ * /proc/self/statm. While either is over budget the governor steps up a
+ * ladder of degradations, each of which also applies those below it:
+ *   1. refresh half as often
+ *   2. stop reading command lines
+ *   3. stop reading status files, so users and memory are not updated
+ *   4. only sample the busiest kTopK processes
+ *   5+. refresh 4, 8 then 16 times less often
+ * It steps back down once usage has stayed well under budget for a while.
+ * Without a budget it only measures.
+ */
+class OverheadGovernor {
+ public:
+  /**
+   * The highest degradation level
+   */
+  static constexpr int kMaxLevel = 7;
+
+  /**
+   * Number of busiest processes sampled from level 4
+   */
+  static constexpr std::size_t kTopK = 64;
+
+  /**
+   * Consecutive refreshes over budget before stepping up
+   */
+  static constexpr int kOverToStepUp = 2;
+
+  /**
+   * Consecutive refreshes under kStepDownShare of the budget before
+   * stepping down
+   */
+  static constexpr int kUnderToStepDown = 5;
+
+  /**
+   * Share of the budget usage must stay under before stepping down. Each
+   * step roughly halves the cost, so stepping down from under half of the
+   * budget should not go straight back over it
+   */
+  static constexpr float kStepDownShare = 0.45f;
+
+  /**
+   * Construct a new governor
+   * @param cpu_budget most of a core the monitor may use, where 1.0 is one
+   * full core, or 0 for no budget
+   * @param memory_budget_kb most resident memory the monitor may use, or 0
+   * for no budget
+   */
+  OverheadGovernor(float cpu_budget, long memory_budget_kb);
+
+  /**
+   * Measure usage since the previous update and move between levels
+   */
+  void Update();
+
+  /**
+   * Apply the current level to what the system samples and how often the
+   * scheduler refreshes
+   * @param system
+   * @param scheduler
+   */
+  void Apply(System& system, RefreshScheduler& scheduler) const;
+
+  /**
+   * The current degradation level, 0 when nothing is degraded
+   * @return
+   */
+  int Level() const;
+
+  /**
+   * A short description of a degradation level
+   * @param level
+   * @return
+   */
+  static char const* Describe(int level);
+
+  /**
+   * The share of a core used since the previous update, smoothed
+   * @return
+   */
+  float CpuUsage() const;
+
+  /**
+   * The monitor's resident memory in KB when last updated
+   * @return
+   */
+  long ResidentKb() const;
+
+  float CpuBudget() const;
+  long MemoryBudgetKb() const;
+
+  /**
+   * Is there a budget to enforce?
+   * @return
+   */
+  bool Enforcing() const;
+
+ private:
+  /**
+   * Cpu time used by this process so far, in seconds
+   * @return
+   */
+  static double CpuSeconds();
+
+  float cpu_budget_;
+  long memory_budget_kb_;
+  int level_{};
+  float cpu_usage_{};
+  long resident_kb_{};
+  int over_{};
+  int under_{};
+  bool settled_{};
+  double cpu_seconds_{};
+  std::chrono::steady_clock::time_point updated_{};
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PID_DIFF_H
+#define PID_DIFF_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * The difference between the pids listed on two successive refreshes,
+ * worked out in a single merge of the two sorted lists
+ */
+struct PidDiff {
+ public:
+  /**
+   * Marks a current pid which was not listed before
+   */
+  static constexpr std::size_t kBorn = ~(std::size_t)0;
+
+  explicit PidDiff(std::pmr::memory_resource* resource);
+
+  /**
+   * For each current pid, its index in the previous list, or kBorn
+   */
+  std::pmr::vector<std::size_t> previous;
+
+  /**
+   * Indices in the previous list of pids which are no longer listed
+   */
+  std::pmr::vector<std::size_t> exited;
+
+  /**
+   * The number of current pids which continue from the previous list
+   */
+  std::size_t continuing{};
+
+  /**
+   * The number of current pids which were not listed before
+   */
+  std::size_t born{};
+};
+
+/**
+ * Diff two ascending pid lists
+ * @param previous
+ * @param current
+ * @param diff
+ */
+void DiffPids(std::vector<int> const& previous,
+              std::pmr::vector<int> const& current, PidDiff& diff);
+
+#endif
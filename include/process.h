@@ -1,9 +1,13 @@
 #ifndef PROCESS_H
 #define PROCESS_H
 
+#include <cstddef>
 #include <string>
 
 #include "linux_parser.h"
+#include "process_history.h"
+#include "sample_scheduler.h"
+#include "string_pool.h"
 
 using LinuxParser::ProcessValues;
 
@@ -16,16 +20,32 @@ class Process {
    * Construct a new process
    * @param uptime The current system uptime in seconds
    * @param process_values process values for this process
+   * @param strings the pool the process values' strings are interned in
    */
-  Process(long uptime, ProcessValues process_values);
+  Process(double uptime, ProcessValues process_values,
+          StringPool const& strings);
 
   /**
    * Update this process with new values. Will re-calculate the
-   * process cpu utilization
+   * process cpu utilization over the time since the previous update,
+   * however long that was
    * @param uptime
    * @param process_values
    */
-  void Update(long uptime, ProcessValues process_values);
+  void Update(double uptime, ProcessValues process_values);
+
+  /**
+   * Advance the current time for a process which was not read on this
+   * refresh. Its values and cpu utilization are left as they were
+   * @param uptime
+   */
+  void Age(double uptime);
+
+  /**
+   * This process's sampling state
+   * @return
+   */
+  SampleState& Sampling();
 
   /**
    * The process id of this process
@@ -52,17 +72,68 @@ class Process {
   float CpuUtilization() const;
 
   /**
-   * The current RAM used by this process
+   * The current RAM used by this process, its resident set (VmRSS)
    * @return
    */
   std::string Ram();
 
+  /**
+   * The values this process was last updated with
+   * @return
+   */
+  ProcessValues const& Values() const;
+
+  /**
+   * The resident set size of this process in KB
+   * @return
+   */
+  long RssKb() const;
+
+  /**
+   * The start time of this process in clock ticks since boot.
+   * Used to tell a new process apart from an exited one with the same pid
+   * @return
+   */
+  long StartTimeTicks() const;
+
+  /**
+   * The slot holding this process's samples in the ProcessHistory arena
+   * @return
+   */
+  int HistorySlot() const;
+
+  /**
+   * Set the slot holding this process's samples in the ProcessHistory arena
+   * @param slot
+   */
+  void HistorySlot(int slot);
+
+  /**
+   * The position of this process in the previous refresh's ordering, or
+   * kNoRank for a process which was not listed then
+   * @return
+   */
+  std::size_t Rank() const;
+
+  /**
+   * Set the position of this process in the current ordering
+   * @param rank
+   */
+  void Rank(std::size_t rank);
+
   /**
    * The uptime of this process in seconds
    * @return
    */
   long int UpTime() const;
 
+  /**
+   * Move this process's strings into a new pool. Used when compacting
+   * the pool its strings are currently interned in
+   * @param strings
+   */
+  void Reintern(StringPool& strings);
+
   /**
    * Does this process have a lower cpu utilization than the
    * process a?
@@ -76,6 +147,11 @@ class Process {
    */
   static const unsigned long MB_KB = 0x1ul << 10ul;
 
+  /**
+   * Rank of a process which has not been ordered yet
+   */
+  static constexpr std::size_t kNoRank = ~(std::size_t)0;
+
  private:
   /**
    * Update the cpu utilization.
@@ -85,14 +161,19 @@ class Process {
   void UpdateUtilization();
 
   /**
-   * The current uptime of the processs
+   * The system uptime at the latest refresh
    */
-  long uptime_{};
+  double uptime_{};
 
   /**
-   * The previous uptime of the process.
+   * The system uptime when the current process values were read
    */
-  long prev_uptime_{};
+  double sample_uptime_{};
+
+  /**
+   * The system uptime when the previous process values were read
+   */
+  double prev_sample_uptime_{};
 
   /**
    * The current process values of the process
@@ -108,6 +189,26 @@ class Process {
    * The current CPU Utilization of the process
    */
   float utilization_{};
+
+  /**
+   * The pool holding the process's user name and command
+   */
+  StringPool const* strings_;
+
+  /**
+   * When this process should next be read
+   */
+  SampleState sampling_{};
+
+  /**
+   * The slot holding the sample history of the process
+   */
+  int history_slot_{ProcessHistory::kNoSlot};
+
+  /**
+   * The position of the process in the previous ordering
+   */
+  std::size_t rank_{kNoRank};
 };
 
 #endif
\ No newline at end of file
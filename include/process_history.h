@@ -0,0 +1,157 @@
+#ifndef PROCESS_HISTORY_H
+#define PROCESS_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Fixed size arena of per-process sample rings.
+ * Every ring lives in one of a fixed number of slots which are all allocated
+ * up front, so pushing a sample never allocates and the memory footprint does
+ * not depend on process churn. Slots are handed out when a process is first
+ * seen and recycled when it exits.
+ */
+class ProcessHistory {
+ public:
+  /**
+   * Number of samples held in each ring
+   */
+  static const std::size_t kSamples = 16;
+
+  /**
+   * Default number of slots. Matches the default kernel pid_max
+   */
+  static const std::size_t kDefaultCapacity = 32768;
+
+  /**
+   * Slot value used for processes which did not get a ring because
+   * the arena was full
+   */
+  static const int kNoSlot = -1;
+
+  /**
+   * Construct a new arena with room for capacity processes
+   * @param capacity
+   */
+  explicit ProcessHistory(std::size_t capacity = kDefaultCapacity);
+
+  /**
+   * Take a free slot from the arena. Returns kNoSlot if the arena is full
+   * @return
+   */
+  int Acquire();
+
+  /**
+   * Return a slot to the arena so it can be used by a new process
+   * @param slot
+   */
+  void Release(int slot);
+
+  /**
+   * Forget all samples held in the provided slot
+   * @param slot
+   */
+  void Clear(int slot);
+
+  /**
+   * Append a sample to the ring in the provided slot, overwriting the
+   * oldest sample once the ring is full
+   * @param slot
+   * @param cpu cpu utilization where 1.0 is one full core
+   * @param rss_kb resident set size in KB
+   */
+  void Push(int slot, float cpu, long rss_kb);
+
+  /**
+   * Render the cpu samples in the provided slot as a sparkline,
+   * oldest sample first
+   * @param slot
+   * @return
+   */
+  std::string CpuSparkline(int slot) const;
+
+  /**
+   * Render the rss samples in the provided slot as a sparkline scaled to
+   * the largest sample in the ring, oldest sample first
+   * @param slot
+   * @return
+   */
+  std::string RssSparkline(int slot) const;
+
+  /**
+   * The number of slots in the arena
+   * @return
+   */
+  std::size_t Capacity() const;
+
+  /**
+   * The number of bytes held by the arena
+   * @return
+   */
+  std::size_t FootprintBytes() const;
+
+  /**
+   * The number of bytes an arena with the provided capacity will hold
+   * @param capacity
+   * @return
+   */
+  static std::size_t FootprintBytes(std::size_t capacity);
+
+ private:
+  /**
+   * Render count samples, each scaled into the range 0 - 1 by the
+   * provided function, as a sparkline
+   * @tparam F
+   * @param slot
+   * @param scale
+   * @return
+   */
+  template <typename F>
+  std::string Sparkline(int slot, F scale) const;
+
+  /**
+   * Index of the oldest sample in the provided slot
+   * @param slot
+   * @return
+   */
+  std::size_t Oldest(int slot) const;
+
+  /**
+   * Number of slots in the arena
+   */
+  std::size_t capacity_;
+
+  // The sample arrays are deliberately left uninitialised. Slots are cleared
+  // when they are acquired, so pages for slots which have never been used
+  // are never touched and do not count towards the monitor's RSS.
+
+  /**
+   * cpu samples. kSamples entries per slot
+   */
+  std::unique_ptr<float[]> cpu_;
+
+  /**
+   * rss samples in KB. kSamples entries per slot
+   */
+  std::unique_ptr<std::uint32_t[]> rss_;
+
+  /**
+   * Index of the next sample to be written in each slot
+   */
+  std::unique_ptr<std::uint8_t[]> head_;
+
+  /**
+   * Number of valid samples in each slot
+   */
+  std::unique_ptr<std::uint8_t[]> count_;
+
+  /**
+   * Stack of slots which are not in use
+   */
+  std::vector<int> free_slots_;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef PROCESS_READER_H
+#define PROCESS_READER_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "linux_parser.h"
+
+/**
+ * Backends a ProcessReader can read process files with
+ */
+enum class ReaderBackend { kSync, kIoUring };
+
+/**
+ * Reads the files of many processes at once. The synchronous backend reads
+ * them one process at a time with LinuxParser::ReadProcessValues, which
+ * costs an open, two reads and a close for every file. The io_uring backend
+ * instead submits an openat, read and close for every file of a batch of
+ * processes with a single io_uring_enter, reading into buffers registered
+ * with the ring and opening into its fixed file table so that no file
+ * descriptors are created. Files which do not fit in a buffer are read
+ * again synchronously.
+ * Readers start synchronous, and stay so if io_uring is not available
+ */
+class ProcessReader {
+ public:
+  /**
+   * Files in flight in a single io_uring batch
+   */
+  static constexpr unsigned int kBatchFiles = 256;
+
+  /**
+   * Size of the buffer each file in a batch is read into
+   */
+  static constexpr std::size_t kFileBufferSize = 4096;
+
+  ProcessReader();
+  ProcessReader(ProcessReader const&) = delete;
+  ProcessReader& operator=(ProcessReader const&) = delete;
+  ~ProcessReader();
+
+  /**
+   * Switch to the io_uring backend, setting up a ring if there is not one
+   * already. Returns false, staying synchronous, if the kernel does not
+   * support everything the backend needs or io_uring is disabled
+   * @return
+   */
+  bool UseIoUring();
+
+  /**
+   * Switch to the synchronous backend, tearing down any ring
+   */
+  void UseSync();
+
+  ReaderBackend Backend() const;
+
+  /**
+   * Read the values of each of the provided processes, reading only the
+   * files the context asks for. values and read are resized to match pids,
+   * and read is set to 0 for each process which has exited
+   * @param context
+   * @param pids
+   * @param values
+   * @param read
+   */
+  void Read(LinuxParser::ProcessParseContext& context,
+            std::pmr::vector<int> const& pids,
+            std::pmr::vector<LinuxParser::ProcessValues>& values,
+            std::pmr::vector<char>& read);
+
+ private:
+  struct Ring;
+
+  /**
+   * Read pids[first, last) with a single batch of io_uring operations.
+   * Returns false if the ring failed, in which case nothing was read
+   * @param context
+   * @param pids
+   * @param first
+   * @param last
+   * @param values
+   * @param read
+   * @return
+   */
+  bool ReadBatch(LinuxParser::ProcessParseContext& context,
+                 std::pmr::vector<int> const& pids, std::size_t first,
+                 std::size_t last,
+                 std::pmr::vector<LinuxParser::ProcessValues>& values,
+                 std::pmr::vector<char>& read);
+
+  std::unique_ptr<Ring> ring_{};
+};
+
+#endif
@@ -19,19 +19,27 @@ class Processor {
    */
   float Utilization();
 
+  /**
+   * The CPU Utilization since the previous call, from values which have
+   * already been read
+   * @param values
+   * @return
+   */
+  float Utilization(CPUValues const& values);
+
   /**
    * Calculate the number of idle ticks
    * @param values
    * @return
    */
-  static long CPUIdle(CPUValues& values);
+  static long CPUIdle(CPUValues const& values);
 
   /**
    * Calculate the number of busy ticks
    * @param values
    * @return
    */
-  static long CPUBusy(CPUValues& values);
+  static long CPUBusy(CPUValues const& values);
 
  private:
   /**
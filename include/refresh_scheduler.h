@@ -0,0 +1,113 @@
+#ifndef REFRESH_SCHEDULER_H
+#define REFRESH_SCHEDULER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * Decides when the next refresh happens.
+ * Pressure stall triggers are registered on /proc/pressure/{cpu,memory,io}
+ * and polled between refreshes. While they stay quiet the interval backs off
+ * towards the calm interval. As soon as one fires the next refresh happens,
+ * unless the previous refresh was less than the stretched fast interval
+ * ago, and the interval drops to the fast interval, then decays back.
+ * Without PSI triggers, for example on older kernels, refreshes happen at a
+ * fixed interval of one second. A trigger which fails, for example when its
+ * cgroup is removed, is dropped, and once none are left refreshes happen at
+ * the calm interval.
+ * Waits can also be woken by input, for example key presses, without
+ * moving the next refresh.
+ */
+class RefreshScheduler {
+ public:
+  /**
+   * Why the last wait ended
+   */
+  enum class Wake { kTimeout, kPressure, kInput };
+
+  /**
+   * Construct a new scheduler
+   * @param fast interval used while the system is under pressure
+   * @param calm longest interval used while the system is calm
+   */
+  RefreshScheduler(std::chrono::milliseconds fast,
+                   std::chrono::milliseconds calm);
+
+  RefreshScheduler(RefreshScheduler const&) = delete;
+  RefreshScheduler& operator=(RefreshScheduler const&) = delete;
+  ~RefreshScheduler();
+
+  /**
+   * Register the pressure triggers. Returns false, leaving the scheduler on
+   * a fixed interval, if none could be registered
+   * @return
+   */
+  bool Arm();
+
+  /**
+   * Wait until the next refresh is due, a pressure trigger fires or
+   * input_fd becomes readable. A wait ended by input leaves the next
+   * refresh due when it was, so the following wait picks up where this one
+   * left off
+   * @param input_fd descriptor to watch for input, or -1 for none
+   * @return why the wait ended
+   */
+  Wake Wait(int input_fd = -1);
+
+  /**
+   * Stretch every interval by a factor, for example to keep the cost of
+   * refreshing down. Pressure can not bring refreshes closer together than
+   * the stretched fast interval
+   * @param factor
+   */
+  void Stretch(int factor);
+
+  /**
+   * The interval the next wait will use
+   * @return
+   */
+  std::chrono::milliseconds Interval() const;
+
+  /**
+   * Are any pressure triggers registered?
+   * @return
+   */
+  bool Armed() const;
+
+  /**
+   * Why the last wait which ended in a refresh ended
+   * @return
+   */
+  Wake LastWake() const;
+
+  /**
+   * Stall threshold for each trigger, in microseconds per window
+   */
+  static const long kStallThresholdUs = 100000;
+
+  /**
+   * Trigger window, in microseconds
+   */
+  static const long kWindowUs = 1000000;
+
+ private:
+  /**
+   * Register a trigger on the named pressure file
+   * @param filename
+   */
+  void ArmTrigger(std::string const& filename);
+
+  std::chrono::milliseconds fast_;
+  std::chrono::milliseconds calm_;
+  std::chrono::milliseconds interval_{1000};
+  int stretch_{1};
+  std::vector<int> triggers_{};
+  Wake last_wake_{Wake::kTimeout};
+  bool waiting_{};
+  bool pressure_{};
+  std::chrono::steady_clock::time_point deadline_{};
+  std::chrono::steady_clock::time_point refreshed_{};
+};
+
+#endif
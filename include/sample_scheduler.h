@@ -0,0 +1,177 @@
+#ifndef SAMPLE_SCHEDULER_H
+#define SAMPLE_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Per-process sampling state kept by the SampleScheduler
+ */
+struct SampleState {
+ public:
+  /**
+   * Index into SampleScheduler's tier intervals. 0 is sampled every tick
+   */
+  std::uint8_t tier{};
+
+  /**
+   * Number of consecutive samples in which the process was quiet
+   */
+  std::uint8_t quiet_samples{};
+
+  /**
+   * The tick on which the process should next be sampled
+   */
+  unsigned long next_tick{};
+};
+
+/**
+ * Decides which processes need their /proc files reading on each tick.
+ * Processes which are using at least the cpu floor are read every tick.
+ * Quiet processes drop down a tier, and so are read less often, each time
+ * they are seen to be quiet for several samples in a row, and go straight
+ * back to the top tier as soon as they are seen to be active again.
+ *
+ * Processes which are not due are still probed every tick by reading only
+ * their stat file, which gives their cpu use. A quiet process which becomes
+ * busy is promoted by its probe, so the cpu use of every process at or
+ * above the floor is always current.
+ */
+class SampleScheduler {
+ public:
+  /**
+   * Number of sampling tiers
+   */
+  static const std::size_t kTiers = 4;
+
+  /**
+   * Number of ticks between samples in each tier
+   */
+  static const unsigned long kTierIntervals[kTiers];
+
+  /**
+   * Number of consecutive quiet samples before a process drops a tier
+   */
+  static const std::uint8_t kQuietSamplesToDemote = 3;
+
+  /**
+   * Construct a new scheduler
+   * @param cpu_floor processes using at least this much cpu, where 1.0 is
+   * one full core, are always sampled every tick
+   */
+  explicit SampleScheduler(float cpu_floor = 0.005f);
+
+  /**
+   * Start a new tick
+   */
+  void BeginTick();
+
+  /**
+   * Should a process with the provided state be read on this tick?
+   * @param state
+   * @param pid
+   * @param utilization the process's cpu utilization when last read
+   * @return
+   */
+  bool Due(SampleState const& state, int pid, float utilization) const;
+
+  /**
+   * Should processes which are not due be probed on this tick? They are
+   * not while a cutoff limits sampling to the busiest processes
+   * @return
+   */
+  bool Probing() const;
+
+  /**
+   * Record that a process has been read and move it between tiers
+   * according to its activity
+   * @param state
+   * @param pid
+   * @param utilization the process's cpu utilization since its last sample
+   */
+  void Sampled(SampleState& state, int pid, float utilization);
+
+  /**
+   * Record that a process which was not due has had its stat file read,
+   * promoting it to be read in full on the next tick if it has become busy
+   * @param state
+   * @param utilization the process's cpu utilization since its last probe
+   */
+  void Probed(SampleState& state, float utilization);
+
+  /**
+   * Record that a new process has been read for the first time
+   * @param state
+   */
+  void Born(SampleState& state);
+
+  /**
+   * Record that a process was not due and so was not read
+   */
+  void Skipped();
+
+  /**
+   * The cpu floor
+   * @return
+   */
+  float CpuFloor() const;
+
+  /**
+   * Set the cpu floor
+   * @param cpu_floor
+   */
+  void CpuFloor(float cpu_floor);
+
+  /**
+   * Only sample the busiest processes. Processes using less cpu than the
+   * cutoff are swept once every slowest tier interval, staggered by pid,
+   * so that they can still be seen to become busy
+   * @param cutoff the least cpu a process may use and still be sampled by
+   * its tier, or a negative value to sample every process by its tier
+   */
+  void Cutoff(float cutoff);
+
+  /**
+   * Number of processes read on the last tick
+   * @return
+   */
+  std::size_t Read() const;
+
+  /**
+   * Number of processes which were not due but were probed on the last
+   * tick
+   * @return
+   */
+  std::size_t Probes() const;
+
+  /**
+   * Number of processes seen on the last tick
+   * @return
+   */
+  std::size_t Seen() const;
+
+ private:
+  /**
+   * Schedule the next sample of a process according to its tier
+   * @param state
+   */
+  void Schedule(SampleState& state) const;
+
+  /**
+   * Schedule the first sample of a process in a lower tier. Processes are
+   * spread across the tier's interval by pid so that processes which
+   * started together are not all read on the same tick
+   * @param state
+   * @param pid
+   */
+  void ScheduleDemoted(SampleState& state, int pid) const;
+
+  float cpu_floor_;
+  float cutoff_{-1.0f};
+  unsigned long tick_{};
+  std::size_t read_{};
+  std::size_t probes_{};
+  std::size_t seen_{};
+};
+
+#endif
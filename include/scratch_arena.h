@@ -0,0 +1,82 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/**
+ * Monotonic arena for memory which only lives for a single refresh.
+ * Allocations are carved out of one preallocated buffer and are all freed at
+ * once by Reset. If a refresh needs more than the buffer holds the overflow
+ * comes from the heap and the buffer is grown on the next Reset, so a steady
+ * state refresh does not touch the heap at all.
+ */
+class ScratchArena {
+ public:
+  /**
+   * Construct a new arena with a buffer of the provided size
+   * @param initial_bytes
+   */
+  explicit ScratchArena(std::size_t initial_bytes = 256 * 1024);
+
+  ScratchArena(ScratchArena const&) = delete;
+  ScratchArena& operator=(ScratchArena const&) = delete;
+
+  /**
+   * The memory resource to allocate scratch memory from
+   * @return
+   */
+  std::pmr::memory_resource* Resource();
+
+  /**
+   * Free everything allocated since the last reset.
+   * Nothing allocated from the arena may be used after this is called
+   */
+  void Reset();
+
+  /**
+   * The size of the preallocated buffer
+   * @return
+   */
+  std::size_t Capacity() const;
+
+ private:
+  /**
+   * Memory resource which forwards to the heap and records how many bytes
+   * have been requested from it
+   */
+  class OverflowResource : public std::pmr::memory_resource {
+   public:
+    std::size_t bytes{};
+
+   private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes,
+                       std::size_t alignment) override;
+    bool do_is_equal(
+        std::pmr::memory_resource const& other) const noexcept override;
+  };
+
+  /**
+   * Size of the preallocated buffer
+   */
+  std::size_t capacity_;
+
+  /**
+   * The preallocated buffer
+   */
+  std::unique_ptr<std::byte[]> buffer_;
+
+  /**
+   * Where allocations which do not fit in the buffer come from
+   */
+  OverflowResource overflow_{};
+
+  /**
+   * The arena itself
+   */
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_;
+};
+
+#endif
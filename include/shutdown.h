@@ -0,0 +1,24 @@
+#ifndef SHUTDOWN_H
+#define SHUTDOWN_H
+
+/**
+ * Lets SIGINT, SIGTERM and SIGHUP stop the monitor cleanly rather than kill
+ * it, so that it can write out what it holds first
+ */
+namespace Shutdown {
+
+/**
+ * Catch the signals. The handler only sets a flag, which the refresh loops
+ * check. Waits are not restarted, so a signal ends the current one
+ */
+void Install();
+
+/**
+ * Has one of the signals been received?
+ * @return
+ */
+bool Requested();
+
+};  // namespace Shutdown
+
+#endif
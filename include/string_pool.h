@@ -0,0 +1,116 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Pool of interned strings.
+ * Each distinct string is stored once, in large blocks, and referred to by a
+ * small integer id. Looking up an id is an index into a vector and interning
+ * a string which is already in the pool does not allocate.
+ */
+class StringPool {
+ public:
+  /**
+   * Id of a string held by the pool
+   */
+  using Id = std::uint32_t;
+
+  /**
+   * Id of the empty string. Always present in the pool
+   */
+  static constexpr Id kEmpty = 0;
+
+  /**
+   * Construct a new pool holding only the empty string
+   */
+  StringPool();
+
+  StringPool(StringPool&&) = default;
+  StringPool& operator=(StringPool&&) = default;
+  StringPool(StringPool const&) = delete;
+  StringPool& operator=(StringPool const&) = delete;
+
+  /**
+   * Return the id of the provided string, adding it to the pool if it
+   * is not already present
+   * @param value
+   * @return
+   */
+  Id Intern(std::string_view value);
+
+  /**
+   * Return the string with the provided id. The view remains valid for as
+   * long as the pool does
+   * @param id
+   * @return
+   */
+  std::string_view View(Id id) const;
+
+  /**
+   * The number of distinct strings held by the pool
+   * @return
+   */
+  std::size_t Size() const;
+
+  /**
+   * The number of bytes of character storage held by the pool
+   * @return
+   */
+  std::size_t StorageBytes() const;
+
+  /**
+   * Differs between every pool constructed, so that ids kept from a pool
+   * which has since been replaced, by compacting it, can be recognised
+   * @return
+   */
+  std::uint64_t Generation() const;
+
+ private:
+  /**
+   * Copy the provided string into block storage and return a view of the copy
+   * @param value
+   * @return
+   */
+  std::string_view Store(std::string_view value);
+
+  /**
+   * Size of each block of character storage
+   */
+  static const std::size_t kBlockSize = 64 * 1024;
+
+  /**
+   * Blocks of character storage. Blocks never move once allocated so views
+   * into them stay valid as the pool grows
+   */
+  std::vector<std::unique_ptr<char[]>> blocks_{};
+
+  /**
+   * Number of bytes used in the last block
+   */
+  std::size_t block_used_{kBlockSize};
+
+  /**
+   * Total number of bytes of character storage allocated
+   */
+  std::size_t storage_bytes_{};
+
+  /**
+   * Interned strings indexed by id
+   */
+  std::vector<std::string_view> strings_{};
+
+  /**
+   * Ids indexed by interned string
+   */
+  std::unordered_map<std::string_view, Id> ids_{};
+
+  std::uint64_t generation_;
+};
+
+#endif
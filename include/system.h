@@ -1,17 +1,141 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "alert_engine.h"
+#include "cpu_topology.h"
+#include "device_rates.h"
+#include "history_store.h"
 #include "process.h"
+#include "process_history.h"
+#include "process_reader.h"
 #include "processor.h"
+#include "sample_scheduler.h"
+#include "scratch_arena.h"
+
+/**
+ * Pressure stall information for each resource
+ */
+struct SystemPressure {
+ public:
+  bool available{};
+  LinuxParser::PressureValues cpu{};
+  LinuxParser::PressureValues memory{};
+  LinuxParser::PressureValues io{};
+};
+
+/**
+ * System wide values sampled by the last refresh
+ */
+struct SystemLoad {
+ public:
+  /**
+   * Share of the cpus in use since the refresh before
+   */
+  float cpu{};
+  float memory{};
+  int running{};
+  int total{};
+};
+
+/**
+ * Limits on how much is read about each process, used to keep the
+ * monitor's own overhead down
+ */
+struct SamplingLimits {
+ public:
+  /**
+   * Read each process's command line
+   */
+  bool command_lines{true};
+
+  /**
+   * Read each process's status file, which gives its user and memory use
+   */
+  bool status{true};
+
+  /**
+   * If not zero, only this many of the busiest processes are sampled by
+   * their tier. The rest are swept slowly
+   */
+  std::size_t top_k{};
+};
+
+/**
+ * Keys the process list can be ordered by
+ */
+enum class ProcessSort { kCpu, kRam, kTime, kPid, kUser };
 
 class System {
  public:
   Processor& Cpu();
+
+  /**
+   * Device rates over the interval between the last two refreshes
+   * @return
+   */
+  DeviceRates& Devices();
+  CpuTopology& Topology();
   std::vector<Process>& Processes();
+
+  /**
+   * System wide values read by the last refresh of the processes, so that
+   * everything showing or recording them shares a single read
+   * @return
+   */
+  SystemLoad const& Load() const;
+
+  /**
+   * The reader process files are read with, synchronously unless it is
+   * switched to io_uring
+   * @return
+   */
+  ProcessReader& Reader();
+
+  /**
+   * Replace the processes of the last refresh with ones made from values,
+   * ordered by the current key, as if a refresh had listed them. Used by
+   * tests which need more processes than the machine is running
+   * @param values
+   * @param strings the pool the values' strings are interned in
+   * @return the processes, as Processes would return them
+   */
+  std::vector<Process>& Adopt(std::vector<ProcessValues> values,
+                              StringPool const& strings);
+
+  /**
+   * Reorder the processes of the last refresh by key. Later refreshes keep
+   * using it
+   * @param key
+   */
+  void Sort(ProcessSort key);
+  ProcessSort SortKey() const;
+
+  /**
+   * Limit what later refreshes read about each process. Values which are
+   * not read keep what they were last read as
+   * @param limits
+   */
+  void Limit(SamplingLimits const& limits);
+  SamplingLimits const& Limits() const;
+  ProcessHistory const& History() const;
+  SampleScheduler const& Sampling() const;
+  void CpuFloor(float cpu_floor);
+  AlertEngine& Alerts();
+
+  /**
+   * The store every refresh is recorded into once it is opened
+   * @return
+   */
+  HistoryStore& Store();
+  StringPool const& Strings() const;
   static float MemoryUtilization();
+  static float MemoryUtilization(LinuxParser::MemoryValues const& values);
+  static SystemPressure Pressure();
   static long UpTime();
   static int TotalProcesses();
   static int RunningProcesses();
@@ -19,9 +143,77 @@ class System {
   static std::string OperatingSystem();
 
  private:
+  void CompactStrings();
+
+  /**
+   * Order the processes listed by the last refresh and copy them into
+   * processes_. They are laid out in the previous refresh's order first,
+   * which is usually nearly sorted already
+   */
+  void Order();
+
+  /**
+   * Copy the values limits_ stop from being read from the previous values
+   * of a process
+   * @param previous
+   * @param current
+   */
+  void KeepUnread(ProcessValues const& previous, ProcessValues& current) const;
+
+  /**
+   * Copy the values a probe, which reads only the stat file, does not read
+   * from the previous values of a process
+   * @param previous
+   * @param current
+   */
+  static void KeepUnprobed(ProcessValues const& previous,
+                           ProcessValues& current);
+
+  /**
+   * Set the scheduler's cutoff to the cpu use of the top_k'th busiest
+   * process
+   */
+  void CutOff();
+
   Processor cpu_ = {};
+  SystemLoad load_{};
+  std::string load_buffer_{};
+  DeviceRates devices_{};
+  CpuTopology topology_{};
   std::vector<Process> processes_ = {};
-  std::map<int, Process> process_by_pid_{};
+  // Live processes in pid order, with their pids alongside for diffing
+  std::vector<Process> known_{};
+  std::vector<int> known_pids_{};
+  std::vector<Process> next_{};
+  std::vector<int> next_pids_{};
+  ProcessHistory history_{};
+  LinuxParser::ProcessParseContext parse_context_{};
+  ProcessReader reader_{};
+  ScratchArena scratch_{};
+  SampleScheduler scheduler_{};
+  AlertEngine alerts_{};
+  HistoryStore store_{};
+  ProcessSort sort_{ProcessSort::kCpu};
+  SamplingLimits limits_{};
+  std::vector<Process*> listed_{};
+  std::vector<Process*> ranked_{};
+  std::vector<Process*> displaced_{};
+
+  /**
+   * A process's place in the order: its value for the sort key, then its
+   * previous rank and its pid to break ties
+   */
+  struct SortEntry {
+    double value;
+    std::size_t rank;
+    int pid;
+    Process* process;
+  };
+  std::vector<SortEntry> entries_{};
+  std::vector<SortEntry> kept_entries_{};
+  std::vector<SortEntry> displaced_entries_{};
+  std::vector<StringPool::Id> users_{};
+  std::vector<std::uint32_t> user_order_{};
 };
 
 #endif
\ No newline at end of file
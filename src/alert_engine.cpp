@@ -0,0 +1,400 @@
+#include "alert_engine.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include <string>
+
+using std::size_t;
+using std::string;
+using std::to_string;
+using std::vector;
+
+/**
+ * Names of each AlertRule::Metric, in order
+ */
+static const char* const kMetricNames[] = {"cpu", "memory", "running",
+                                           "total", "rss"};
+
+/**
+ * Parse a threshold with an optional unit suffix
+ * @param text
+ * @param value
+ * @return
+ */
+bool ParseThreshold(string const& text, double& value) {
+  size_t end;
+  try {
+    value = std::stod(text, &end);
+  } catch (...) {
+    return false;
+  }
+  string suffix = text.substr(end);
+  if (suffix.empty()) {
+    return true;
+  } else if (suffix == "%") {
+    value /= 100.0;
+  } else if (suffix == "cores" || suffix == "xcores") {
+    value *= (double)sysconf(_SC_NPROCESSORS_ONLN);
+  } else if (suffix == "M") {
+    value *= (double)Process::MB_KB;
+  } else if (suffix == "G") {
+    value *= (double)(Process::MB_KB * Process::MB_KB);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse a duration with an optional s, m or h suffix into seconds
+ * @param text
+ * @param seconds
+ * @return
+ */
+bool ParseDuration(string const& text, double& seconds) {
+  size_t end;
+  try {
+    seconds = std::stod(text, &end);
+  } catch (...) {
+    return false;
+  }
+  string suffix = text.substr(end);
+  if (suffix == "m") {
+    seconds *= 60.0;
+  } else if (suffix == "h") {
+    seconds *= 3600.0;
+  } else if (!suffix.empty() && suffix != "s") {
+    return false;
+  }
+  return seconds >= 0.0;
+}
+
+bool AlertEngine::Compile(string const& path, AlertEngine& engine,
+                          string& error) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    error = "could not open alert rules " + path;
+    return false;
+  }
+  string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t") == string::npos) {
+      continue;
+    }
+    AlertRule rule;
+    if (!engine.ParseRule(line, rule, error)) {
+      error = path + ":" + to_string(line_number) + ": " + error;
+      return false;
+    }
+    engine.rules_.push_back(rule);
+  }
+  engine.Plan();
+  return true;
+}
+
+bool AlertEngine::ParseRule(string const& line, AlertRule& rule,
+                            string& error) {
+  std::istringstream line_stream(line);
+  string scope, metric, op, threshold, duration, action, extra;
+  if (!(line_stream >> rule.name >> scope >> metric >> op >> threshold >>
+        duration >> action) ||
+      (line_stream >> extra)) {
+    error = "expected: name scope metric op threshold for action";
+    return false;
+  }
+
+  if (scope == "system") {
+    rule.scope = AlertRule::Scope::kSystem;
+  } else if (scope == "process") {
+    rule.scope = AlertRule::Scope::kProcess;
+  } else {
+    error = "unknown scope " + scope;
+    return false;
+  }
+
+  auto name = std::find(std::begin(kMetricNames), std::end(kMetricNames),
+                        metric);
+  if (name == std::end(kMetricNames)) {
+    error = "unknown metric " + metric;
+    return false;
+  }
+  rule.metric = (AlertRule::Metric)(name - std::begin(kMetricNames));
+  bool process_metric = rule.metric == AlertRule::Metric::kCpu ||
+                        rule.metric == AlertRule::Metric::kRss;
+  bool system_metric = rule.metric != AlertRule::Metric::kRss;
+  if ((rule.scope == AlertRule::Scope::kProcess && !process_metric) ||
+      (rule.scope == AlertRule::Scope::kSystem && !system_metric)) {
+    error = "metric " + metric + " is not available for " + scope;
+    return false;
+  }
+
+  if (op == ">") {
+    rule.op = AlertRule::Op::kGreater;
+  } else if (op == ">=") {
+    rule.op = AlertRule::Op::kGreaterEqual;
+  } else if (op == "<") {
+    rule.op = AlertRule::Op::kLess;
+  } else if (op == "<=") {
+    rule.op = AlertRule::Op::kLessEqual;
+  } else {
+    error = "unknown operator " + op;
+    return false;
+  }
+
+  if (!ParseThreshold(threshold, rule.threshold)) {
+    error = "invalid threshold " + threshold;
+    return false;
+  }
+  if (!ParseDuration(duration, rule.for_seconds)) {
+    error = "invalid duration " + duration;
+    return false;
+  }
+
+  Action parsed;
+  size_t colon = action.find(':');
+  string kind = action.substr(0, colon);
+  if (colon == string::npos || colon + 1 == action.size()) {
+    error = "invalid action " + action;
+    return false;
+  } else if (kind == "log") {
+    parsed.kind = Action::Kind::kLog;
+  } else if (kind == "exec") {
+    parsed.kind = Action::Kind::kExec;
+  } else {
+    error = "unknown action " + kind;
+    return false;
+  }
+  parsed.target = action.substr(colon + 1);
+
+  // Rules sharing an action share a single open log file
+  auto existing = std::find_if(
+      actions_.begin(), actions_.end(), [&](Action const& candidate) {
+        return candidate.kind == parsed.kind &&
+               candidate.target == parsed.target;
+      });
+  if (existing == actions_.end()) {
+    if (parsed.kind == Action::Kind::kLog) {
+      parsed.log.reset(new std::ofstream(parsed.target, std::ios::app));
+      if (!parsed.log->is_open()) {
+        error = "could not open alert log " + parsed.target;
+        return false;
+      }
+    }
+    actions_.push_back(std::move(parsed));
+    existing = actions_.end() - 1;
+  }
+  rule.action = existing - actions_.begin();
+  return true;
+}
+
+void AlertEngine::Plan() {
+  system_state_.assign(rules_.size(), RuleState{});
+  process_state_.assign(rules_.size(), {});
+  system_rules_.clear();
+  process_groups_.clear();
+
+  for (size_t i = 0; i < rules_.size(); ++i) {
+    AlertRule const& rule = rules_[i];
+    if (rule.scope == AlertRule::Scope::kSystem) {
+      system_rules_.push_back(i);
+      continue;
+    }
+    bool above = rule.op == AlertRule::Op::kGreater ||
+                 rule.op == AlertRule::Op::kGreaterEqual;
+    auto group = std::find_if(
+        process_groups_.begin(), process_groups_.end(),
+        [&](ProcessGroup const& candidate) {
+          return candidate.metric == rule.metric && candidate.above == above;
+        });
+    if (group == process_groups_.end()) {
+      process_groups_.push_back(ProcessGroup{rule.metric, above, {}});
+      group = process_groups_.end() - 1;
+    }
+    group->rules.push_back(i);
+  }
+
+  // Order each group so that the rules a value satisfies are always a
+  // prefix of it, letting evaluation stop at the first rule that fails.
+  // Of two rules with the same threshold the inclusive one comes first
+  for (auto& group : process_groups_) {
+    std::sort(group.rules.begin(), group.rules.end(),
+              [&](size_t a, size_t b) {
+                AlertRule const& ra = rules_[a];
+                AlertRule const& rb = rules_[b];
+                if (ra.threshold != rb.threshold) {
+                  return group.above ? ra.threshold < rb.threshold
+                                     : ra.threshold > rb.threshold;
+                }
+                bool a_inclusive = ra.op == AlertRule::Op::kGreaterEqual ||
+                                   ra.op == AlertRule::Op::kLessEqual;
+                bool b_inclusive = rb.op == AlertRule::Op::kGreaterEqual ||
+                                   rb.op == AlertRule::Op::kLessEqual;
+                return a_inclusive && !b_inclusive;
+              });
+  }
+}
+
+bool AlertEngine::Empty() const { return rules_.empty(); }
+
+size_t AlertEngine::Rules() const { return rules_.size(); }
+
+size_t AlertEngine::Firing() const { return firing_; }
+
+bool AlertEngine::Matches(AlertRule const& rule, double value) {
+  switch (rule.op) {
+    case AlertRule::Op::kGreater:
+      return value > rule.threshold;
+    case AlertRule::Op::kGreaterEqual:
+      return value >= rule.threshold;
+    case AlertRule::Op::kLess:
+      return value < rule.threshold;
+    case AlertRule::Op::kLessEqual:
+      return value <= rule.threshold;
+  }
+  return false;
+}
+
+void AlertEngine::Evaluate(double cpu, double memory, int running, int total,
+                           vector<Process>& processes) {
+  if (Empty()) {
+    return;
+  }
+  double now = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count();
+  double system_values[kMetrics]{};
+  system_values[(size_t)AlertRule::Metric::kCpu] = cpu;
+  system_values[(size_t)AlertRule::Metric::kMemory] = memory;
+  system_values[(size_t)AlertRule::Metric::kRunning] = running;
+  system_values[(size_t)AlertRule::Metric::kTotal] = total;
+  Evaluate(now, system_values, processes);
+}
+
+void AlertEngine::Evaluate(double now, double const* system_values,
+                           vector<Process>& processes) {
+  ++tick_;
+  ReapHooks();
+  EvaluateSystem(now, system_values);
+  EvaluateProcesses(now, processes);
+  // Alerts are written out once per refresh rather than once per line
+  for (auto& action : actions_) {
+    if (action.log) {
+      action.log->flush();
+    }
+  }
+}
+
+void AlertEngine::EvaluateSystem(double now, double const* system_values) {
+  for (size_t rule : system_rules_) {
+    double value = system_values[(size_t)rules_[rule].metric];
+    RuleState& state = system_state_[rule];
+    if (Matches(rules_[rule], value)) {
+      Hold(rule, state, now, value, nullptr);
+    } else {
+      if (state.firing) {
+        --firing_;
+      }
+      state = RuleState{};
+    }
+  }
+}
+
+void AlertEngine::EvaluateProcesses(double now, vector<Process>& processes) {
+  if (process_groups_.empty()) {
+    return;
+  }
+  for (auto& process : processes) {
+    for (auto const& group : process_groups_) {
+      double value = group.metric == AlertRule::Metric::kCpu
+                         ? (double)process.CpuUtilization()
+                         : (double)process.RssKb();
+      for (size_t rule : group.rules) {
+        if (!Matches(rules_[rule], value)) {
+          break;
+        }
+        Hold(rule, process_state_[rule][process.Pid()], now, value, &process);
+      }
+    }
+  }
+
+  // Anything not held on this tick has stopped matching or exited. Only
+  // processes which matched on the previous tick are visited
+  for (auto& states : process_state_) {
+    for (auto state = states.begin(); state != states.end();) {
+      if (state->second.last_tick == tick_) {
+        ++state;
+        continue;
+      }
+      if (state->second.firing) {
+        --firing_;
+      }
+      state = states.erase(state);
+    }
+  }
+}
+
+void AlertEngine::Hold(size_t rule, RuleState& state, double now,
+                       double value, Process* process) {
+  if (state.last_tick == 0) {
+    state.true_since = now;
+  }
+  state.last_tick = tick_;
+  if (!state.firing && now - state.true_since >= rules_[rule].for_seconds) {
+    state.firing = true;
+    ++firing_;
+    Fire(rules_[rule], value, process);
+  }
+}
+
+void AlertEngine::Fire(AlertRule const& rule, double value,
+                       Process* process) {
+  string subject =
+      process == nullptr ? string("system") : to_string(process->Pid());
+  string value_text = to_string(value);
+  Action& action = actions_[rule.action];
+
+  if (action.kind == Action::Kind::kLog) {
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S",
+                  std::localtime(&now));
+    *action.log << timestamp << " " << rule.name << " " << subject << " "
+                << kMetricNames[(size_t)rule.metric] << "=" << value_text;
+    if (process != nullptr) {
+      *action.log << " user=" << process->User()
+                  << " command=" << process->Command();
+    }
+    *action.log << '\n';
+    return;
+  }
+
+  // The hook gets the rule name, the subject and the value as arguments.
+  // It is not waited for so that a slow hook can not stall sampling
+  pid_t child = fork();
+  if (child == 0) {
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execl(action.target.c_str(), action.target.c_str(), rule.name.c_str(),
+          subject.c_str(), value_text.c_str(), (char*)nullptr);
+    _exit(127);
+  } else if (child > 0) {
+    ++running_hooks_;
+  }
+}
+
+void AlertEngine::ReapHooks() {
+  while (running_hooks_ > 0 && waitpid(-1, nullptr, WNOHANG) > 0) {
+    --running_hooks_;
+  }
+}
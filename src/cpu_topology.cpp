@@ -0,0 +1,94 @@
+#include "cpu_topology.h"
+
+#include <algorithm>
+
+#include "processor.h"
+
+using LinuxParser::CPUValues;
+using std::size_t;
+using std::vector;
+
+CpuTopology::CpuTopology() {
+  vector<LinuxParser::NumaNodeValues> nodes;
+  LinuxParser::NumaNodes(nodes);
+  LinuxParser::CoreUtilizations(buffer_, values_);
+  if (nodes.empty()) {
+    LinuxParser::NumaNodeValues node{};
+    for (size_t cpu = 0; cpu < values_.size(); ++cpu) {
+      node.cpus.push_back((int)cpu);
+    }
+    nodes.push_back(node);
+  }
+  for (auto const& node : nodes) {
+    NodeLoad load{};
+    load.id = node.id;
+    load.cpus = node.cpus;
+    for (int cpu : node.cpus) {
+      if ((size_t)cpu >= node_of_cpu_.size()) {
+        node_of_cpu_.resize(cpu + 1, -1);
+      }
+      node_of_cpu_[cpu] = (int)nodes_.size();
+    }
+    nodes_.push_back(load);
+  }
+  cores_.resize(std::max(values_.size(), node_of_cpu_.size()));
+}
+
+void CpuTopology::Update(vector<Process> const& processes) {
+  values_.swap(prev_values_);
+  LinuxParser::CoreUtilizations(buffer_, values_);
+  if (values_.size() > cores_.size()) {
+    cores_.resize(values_.size());
+  }
+  prev_values_.resize(values_.size());
+  for (size_t cpu = 0; cpu < cores_.size(); ++cpu) {
+    CoreLoad& core = cores_[cpu];
+    core = CoreLoad{};
+    if (cpu >= values_.size()) {
+      continue;
+    }
+    long idle = Processor::CPUIdle(values_[cpu]);
+    long busy = Processor::CPUBusy(values_[cpu]);
+    long idle_delta = idle - Processor::CPUIdle(prev_values_[cpu]);
+    long busy_delta = busy - Processor::CPUBusy(prev_values_[cpu]);
+    core.utilization = std::clamp(
+        (float)busy_delta / std::max((float)(busy_delta + idle_delta), 1.0f),
+        0.0f, 1.0f);
+  }
+
+  // The processor field comes with the stat file every process is read
+  // from, so attributing them costs no extra reads
+  for (auto const& process : processes) {
+    int cpu = process.Values().processor;
+    if (cpu >= 0 && (size_t)cpu < cores_.size()) {
+      ++cores_[cpu].processes;
+      cores_[cpu].process_cpu += process.CpuUtilization();
+    }
+  }
+
+  for (auto& node : nodes_) {
+    node.utilization = 0;
+    node.processes = 0;
+    node.process_cpu = 0;
+    for (int cpu : node.cpus) {
+      if ((size_t)cpu < cores_.size()) {
+        node.utilization += cores_[cpu].utilization;
+        node.processes += cores_[cpu].processes;
+        node.process_cpu += cores_[cpu].process_cpu;
+      }
+    }
+    node.utilization /= std::max((float)node.cpus.size(), 1.0f);
+  }
+}
+
+vector<NodeLoad> const& CpuTopology::Nodes() const { return nodes_; }
+
+vector<CoreLoad> const& CpuTopology::Cores() const { return cores_; }
+
+int CpuTopology::NodeOf(int cpu) const {
+  if (cpu < 0 || (size_t)cpu >= node_of_cpu_.size() ||
+      node_of_cpu_[cpu] < 0) {
+    return -1;
+  }
+  return nodes_[node_of_cpu_[cpu]].id;
+}
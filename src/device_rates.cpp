@@ -0,0 +1,136 @@
+#include "device_rates.h"
+
+#include <algorithm>
+#include <cstring>
+
+using LinuxParser::DiskStatsValues;
+using LinuxParser::DiskValues;
+using LinuxParser::InterfaceValues;
+using LinuxParser::NetworkValues;
+using std::size_t;
+using std::vector;
+
+/**
+ * Find the previous values of the device named name. Devices are listed in
+ * a stable order, so the search starts where the last one left off and a
+ * full update stays linear in the number of devices
+ * @tparam Values
+ * @param name
+ * @param previous
+ * @param count
+ * @param cursor index to start searching from, advanced past a match
+ * @return the previous values, or nullptr for a new device
+ */
+template <typename Values>
+static Values const* Previous(char const* name, Values const* previous,
+                              size_t count, size_t& cursor) {
+  for (size_t i = cursor; i < count; ++i) {
+    if (std::strcmp(previous[i].name, name) == 0) {
+      cursor = i + 1;
+      return &previous[i];
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * The per second rate of a counter, or zero if it went backwards
+ * @param current
+ * @param previous
+ * @param seconds
+ * @return
+ */
+static double Rate(long current, long previous, double seconds) {
+  return current >= previous ? (double)(current - previous) / seconds : 0.0;
+}
+
+DeviceRates::DeviceRates()
+    : network_(new NetworkValues()),
+      prev_network_(new NetworkValues()),
+      disks_(new DiskStatsValues()),
+      prev_disks_(new DiskStatsValues()) {
+  interface_rates_.reserve(LinuxParser::kMaxDevices);
+  disk_rates_.reserve(LinuxParser::kMaxDevices);
+}
+
+void DeviceRates::Update() {
+  network_.swap(prev_network_);
+  disks_.swap(prev_disks_);
+  LinuxParser::NetworkDevices(buffer_, *network_);
+  LinuxParser::DiskStats(buffer_, *disks_);
+
+  auto now = std::chrono::steady_clock::now();
+  double seconds = std::max(
+      std::chrono::duration<double>(now - updated_).count(), 0.001);
+  updated_ = now;
+
+  interface_rates_.clear();
+  size_t cursor = 0;
+  for (size_t i = 0; i < network_->count; ++i) {
+    InterfaceValues const& current = network_->interfaces[i];
+    InterfaceValues const* previous =
+        Previous(current.name, prev_network_->interfaces.data(),
+                 prev_network_->count, cursor);
+    InterfaceRate rate{};
+    rate.name = current.name;
+    if (previous != nullptr) {
+      rate.rx_bytes = Rate(current.rx_bytes, previous->rx_bytes, seconds);
+      rate.tx_bytes = Rate(current.tx_bytes, previous->tx_bytes, seconds);
+      rate.rx_packets = Rate(current.rx_packets, previous->rx_packets, seconds);
+      rate.tx_packets = Rate(current.tx_packets, previous->tx_packets, seconds);
+    }
+    interface_rates_.push_back(rate);
+  }
+
+  disk_rates_.clear();
+  cursor = 0;
+  for (size_t i = 0; i < disks_->count; ++i) {
+    DiskValues const& current = disks_->disks[i];
+    DiskValues const* previous = Previous(
+        current.name, prev_disks_->disks.data(), prev_disks_->count, cursor);
+    DiskRate rate{};
+    rate.name = current.name;
+    if (previous != nullptr) {
+      rate.reads = Rate(current.reads, previous->reads, seconds);
+      rate.writes = Rate(current.writes, previous->writes, seconds);
+      rate.read_bytes =
+          Rate(current.sectors_read, previous->sectors_read, seconds) *
+          kSectorSize;
+      rate.write_bytes =
+          Rate(current.sectors_written, previous->sectors_written, seconds) *
+          kSectorSize;
+      rate.utilization = std::min(
+          (float)(Rate(current.io_ms, previous->io_ms, seconds) / 1000.0),
+          1.0f);
+    }
+    disk_rates_.push_back(rate);
+  }
+}
+
+void DeviceRates::TopInterfaces(size_t k, vector<InterfaceRate>& out) const {
+  out.assign(interface_rates_.begin(), interface_rates_.end());
+  k = std::min(k, out.size());
+  std::partial_sort(out.begin(), out.begin() + k, out.end(),
+                    [](InterfaceRate const& a, InterfaceRate const& b) {
+                      return a.rx_bytes + a.tx_bytes > b.rx_bytes + b.tx_bytes;
+                    });
+  out.resize(k);
+}
+
+void DeviceRates::TopDisks(size_t k, vector<DiskRate>& out) const {
+  out.assign(disk_rates_.begin(), disk_rates_.end());
+  k = std::min(k, out.size());
+  std::partial_sort(out.begin(), out.begin() + k, out.end(),
+                    [](DiskRate const& a, DiskRate const& b) {
+                      if (a.utilization != b.utilization) {
+                        return a.utilization > b.utilization;
+                      }
+                      return a.read_bytes + a.write_bytes >
+                             b.read_bytes + b.write_bytes;
+                    });
+  out.resize(k);
+}
+
+size_t DeviceRates::Interfaces() const { return network_->count; }
+
+size_t DeviceRates::Disks() const { return disks_->count; }
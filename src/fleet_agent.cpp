@@ -0,0 +1,139 @@
+#include "fleet_agent.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <utility>
+
+#include "linux_parser.h"
+#include "shutdown.h"
+
+using std::string;
+
+FleetAgent::FleetAgent(string host, int port)
+    : host_(std::move(host)), port_(port) {}
+
+FleetAgent::~FleetAgent() { Disconnect(); }
+
+void FleetAgent::Run(System& system, RefreshScheduler& refresh,
+                     OverheadGovernor& governor) {
+  while (!Shutdown::Requested()) {
+    Send(system);
+    governor.Update();
+    governor.Apply(system, refresh);
+    refresh.Wait();
+  }
+}
+
+bool FleetAgent::Send(System& system) {
+  // Sample even while disconnected so that rates stay correct
+  std::vector<Process>& processes = system.Processes();
+  FleetProtocol::SystemValues values;
+  values.uptime = LinuxParser::PreciseUpTime();
+  SystemLoad const& load = system.Load();
+  values.cpu = load.cpu;
+  values.memory = load.memory;
+  values.running = load.running;
+  values.total = load.total;
+
+  if (fd_ < 0 && !Connect()) {
+    return false;
+  }
+  out_.erase(out_.begin(), out_.begin() + out_sent_);
+  out_sent_ = 0;
+  encoder_.Snapshot(values, processes, system.Strings(), out_);
+  if (out_.size() > kMaxQueued) {
+    // The aggregator is not keeping up. Every frame is a delta from the
+    // one before so none can be dropped, but a new connection can start
+    // again from a full snapshot
+    Disconnect();
+    return false;
+  }
+  return Flush();
+}
+
+std::size_t FleetAgent::Queued() const { return out_.size() - out_sent_; }
+
+bool FleetAgent::Connect() {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses;
+  if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints,
+                  &addresses) != 0) {
+    return false;
+  }
+  // A connection completes in the background, so whether an address works
+  // is only known later. Try each address in turn on successive connects
+  std::size_t count = 0;
+  for (addrinfo* address = addresses; address != nullptr;
+       address = address->ai_next) {
+    ++count;
+  }
+  addrinfo* address = addresses;
+  for (std::size_t i = 0; i < next_address_ % count; ++i) {
+    address = address->ai_next;
+  }
+  fd_ = socket(address->ai_family,
+               address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+               address->ai_protocol);
+  if (fd_ >= 0 && connect(fd_, address->ai_addr, address->ai_addrlen) != 0 &&
+      errno != EINPROGRESS) {
+    close(fd_);
+    fd_ = -1;
+  }
+  freeaddrinfo(addresses);
+  established_ = false;
+  if (fd_ < 0) {
+    ++next_address_;
+    return false;
+  }
+  int on = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  // A new connection starts from a full snapshot
+  encoder_.Reset();
+  char name[256] = {};
+  gethostname(name, sizeof(name) - 1);
+  out_.clear();
+  out_sent_ = 0;
+  encoder_.Hello(name, out_);
+  return true;
+}
+
+bool FleetAgent::Flush() {
+  while (out_sent_ < out_.size()) {
+    ssize_t count = send(fd_, out_.data() + out_sent_,
+                         out_.size() - out_sent_, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;  // still connecting, or the socket's buffer is full
+    }
+    if (count <= 0) {
+      Disconnect();
+      return false;
+    }
+    out_sent_ += count;
+    established_ = true;
+  }
+  return true;
+}
+
+void FleetAgent::Disconnect() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+    if (!established_) {
+      ++next_address_;
+    }
+  }
+  out_.clear();
+  out_sent_ = 0;
+}
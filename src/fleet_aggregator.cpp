@@ -0,0 +1,384 @@
+#include "fleet_aggregator.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+using FleetProtocol::FrameReader;
+using std::size_t;
+using std::string;
+using std::uint8_t;
+using std::vector;
+
+/**
+ * Is process a busier than process b?
+ * @param a
+ * @param b
+ * @return
+ */
+static bool Busier(FleetProcess const* a, FleetProcess const* b) {
+  return a->cpu > b->cpu;
+}
+
+/**
+ * Read the next pid of a pid ordered section, delta coded from the one
+ * before. Returns false, failing the frame, if it is not larger than the
+ * one before or is out of range
+ * @param reader
+ * @param pid the previous pid, updated to the next
+ * @return
+ */
+static bool NextPid(FrameReader& reader, int& pid) {
+  std::uint64_t delta = reader.Varint();
+  if (delta == 0 ||
+      delta > (std::uint64_t)(std::numeric_limits<int>::max() - pid)) {
+    return false;
+  }
+  pid += (int)delta;
+  return true;
+}
+
+/**
+ * Apply a delta read from a frame to a value. A bad agent may send any
+ * delta, so this wraps rather than overflowing
+ * @param value
+ * @param delta
+ */
+static void AddDelta(std::int64_t& value, std::int64_t delta) {
+  value = (std::int64_t)((std::uint64_t)value + (std::uint64_t)delta);
+}
+
+bool FleetHost::Apply(FrameReader& reader, StringPool& strings) {
+  system.uptime = (double)reader.Varint() / 100.0;
+  system.cpu = (float)((double)reader.Varint() / FleetProtocol::kUtilizationScale);
+  system.memory =
+      (float)((double)reader.Varint() / FleetProtocol::kUtilizationScale);
+  system.running = (long)reader.Varint();
+  system.total = (long)reader.Varint();
+
+  exited_.clear();
+  size_t count = reader.Varint();
+  int pid = 0;
+  for (size_t i = 0; i < count && reader.Ok(); ++i) {
+    if (!NextPid(reader, pid)) {
+      return false;
+    }
+    exited_.push_back(pid);
+  }
+
+  // Walk the pid ordered processes, the exited pids and the new and changed
+  // sections of the frame together, building the next process list in a
+  // single pass
+  next_.clear();
+  auto existing = processes.begin();
+  auto exited = exited_.begin();
+  auto copy_until = [&](int limit) {
+    for (; existing != processes.end() && existing->pid < limit; ++existing) {
+      while (exited != exited_.end() && *exited < existing->pid) {
+        ++exited;
+      }
+      if (exited != exited_.end() && *exited == existing->pid) {
+        continue;
+      }
+      next_.push_back(*existing);
+    }
+  };
+
+  // New processes and changed processes are each in pid order, but are
+  // interleaved with each other, so apply new processes to a copy first
+  size_t born = reader.Varint();
+  pid = 0;
+  for (size_t i = 0; i < born && reader.Ok(); ++i) {
+    if (!NextPid(reader, pid)) {
+      return false;
+    }
+    copy_until(pid);
+    FleetProcess process{};
+    process.pid = pid;
+    Fields(reader, 0xff, strings, process);
+    next_.push_back(process);
+    // A reused pid replaces the process which had it
+    if (existing != processes.end() && existing->pid == pid) {
+      ++existing;
+    }
+  }
+  copy_until(std::numeric_limits<int>::max());
+  processes.swap(next_);
+
+  size_t changed = reader.Varint();
+  pid = 0;
+  auto process = processes.begin();
+  for (size_t i = 0; i < changed && reader.Ok(); ++i) {
+    if (!NextPid(reader, pid)) {
+      return false;
+    }
+    uint8_t mask = reader.Byte();
+    while (process != processes.end() && process->pid < pid) {
+      ++process;
+    }
+    if (process == processes.end() || process->pid != pid) {
+      return false;  // a change to a process we were never told about
+    }
+    Fields(reader, mask, strings, *process);
+  }
+
+  UpdateTop();
+  return reader.Ok() && reader.Done();
+}
+
+void FleetHost::Fields(FrameReader& reader, uint8_t mask, StringPool& strings,
+                       FleetProcess& process) {
+  if (mask & FleetProtocol::kUserBit) {
+    process.user = strings.Intern(reader.Bytes());
+  }
+  if (mask & FleetProtocol::kCommandBit) {
+    process.command = strings.Intern(reader.Bytes());
+  }
+  if (mask & FleetProtocol::kVmSizeBit) {
+    AddDelta(process.vm_size, reader.Signed());
+  }
+  if (mask & FleetProtocol::kVmRssBit) {
+    AddDelta(process.vm_rss, reader.Signed());
+  }
+  if (mask & FleetProtocol::kUtimeBit) {
+    AddDelta(process.utime_ticks, reader.Signed());
+  }
+  if (mask & FleetProtocol::kStimeBit) {
+    AddDelta(process.stime_ticks, reader.Signed());
+  }
+  if (mask & FleetProtocol::kStartTimeBit) {
+    AddDelta(process.starttime_ticks, reader.Signed());
+  }
+  if (mask & FleetProtocol::kCpuBit) {
+    AddDelta(process.cpu, reader.Signed());
+  }
+}
+
+void FleetHost::UpdateTop() {
+  top_.clear();
+  for (auto const& process : processes) {
+    top_.push_back(&process);
+  }
+  size_t n = std::min(kTopProcesses, top_.size());
+  std::partial_sort(top_.begin(), top_.begin() + n, top_.end(), Busier);
+  top_.resize(n);
+}
+
+void FleetHost::Reintern(StringPool const& from, StringPool& to) {
+  for (auto& process : processes) {
+    process.user = to.Intern(from.View(process.user));
+    process.command = to.Intern(from.View(process.command));
+  }
+}
+
+vector<FleetProcess const*> const& FleetHost::Top() const { return top_; }
+
+FleetAggregator::~FleetAggregator() {
+  for (auto& connection : connections_) {
+    close(connection.fd);
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+  }
+}
+
+bool FleetAggregator::Listen(int port, string& error) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    error = string("socket: ") + std::strerror(errno);
+    return false;
+  }
+  int on = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons((std::uint16_t)port);
+  if (bind(listen_fd_, (sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    error = "listen on port " + std::to_string(port) + ": " +
+            std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool FleetAggregator::Pump(int timeout_ms, int input_fd) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  vector<pollfd> fds;
+  bool input = false;
+  while (!input) {
+    int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now())
+                        .count();
+    if (remaining <= 0) {
+      break;
+    }
+    fds.clear();
+    fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+    for (auto const& connection : connections_) {
+      fds.push_back(pollfd{connection.fd, POLLIN, 0});
+    }
+    if (input_fd >= 0) {
+      fds.push_back(pollfd{input_fd, POLLIN, 0});
+    }
+    int ready = poll(fds.data(), fds.size(), remaining);
+    if (ready < 0 && errno == EINTR) {
+      // Let the caller see whatever the signal asked for
+      break;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    input = input_fd >= 0 && fds.back().revents != 0;
+    // Receive before accepting so that fds still lines up with connections_
+    size_t open = 0;
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      if (fds[i + 1].revents == 0 || Receive(connections_[i])) {
+        if (open != i) {
+          connections_[open] = std::move(connections_[i]);
+        }
+        ++open;
+      } else {
+        close(connections_[i].fd);
+      }
+    }
+    connections_.resize(open);
+    if (fds[0].revents & POLLIN) {
+      Accept();
+    }
+  }
+  if (strings_.Size() > 2 * Processes() + 4096) {
+    CompactStrings();
+  }
+  return input;
+}
+
+void FleetAggregator::Accept() {
+  while (true) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    Connection connection;
+    connection.fd = fd;
+    connection.host.reset(new FleetHost());
+    connections_.push_back(std::move(connection));
+  }
+}
+
+bool FleetAggregator::Receive(Connection& connection) {
+  const size_t kReadSize = 64 * 1024;
+  while (true) {
+    size_t used = connection.buffer.size();
+    connection.buffer.resize(used + kReadSize);
+    ssize_t count = read(connection.fd, connection.buffer.data() + used,
+                         kReadSize);
+    connection.buffer.resize(used + std::max(count, (ssize_t)0));
+    if (count == 0) {
+      return false;  // the agent went away
+    }
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      return errno == EINTR;
+    }
+    bytes_ += count;
+  }
+
+  // Apply every complete frame, then drop them from the buffer in one go
+  vector<uint8_t>& buffer = connection.buffer;
+  while (buffer.size() - connection.consumed >= FleetProtocol::kHeaderSize) {
+    uint8_t const* header = buffer.data() + connection.consumed;
+    size_t length = 0;
+    for (size_t i = 0; i < FleetProtocol::kHeaderSize; ++i) {
+      length |= (size_t)header[i] << (8 * i);
+    }
+    if (length > FleetProtocol::kMaxPayload) {
+      return false;
+    }
+    if (buffer.size() - connection.consumed <
+        FleetProtocol::kHeaderSize + length) {
+      break;
+    }
+    if (!Apply(connection, header + FleetProtocol::kHeaderSize, length)) {
+      return false;
+    }
+    connection.consumed += FleetProtocol::kHeaderSize + length;
+  }
+  buffer.erase(buffer.begin(), buffer.begin() + connection.consumed);
+  connection.consumed = 0;
+  return true;
+}
+
+bool FleetAggregator::Apply(Connection& connection, uint8_t const* payload,
+                            size_t size) {
+  FrameReader reader(payload, size);
+  uint8_t type = reader.Byte();
+  FleetHost& host = *connection.host;
+  if (type == FleetProtocol::kHello) {
+    host.name = string(reader.Bytes());
+    host.clock_ticks = std::max((long)reader.Varint(), 1l);
+    return reader.Ok();
+  }
+  if (type == FleetProtocol::kSnapshot && !host.name.empty()) {
+    ++snapshots_;
+    return host.Apply(reader, strings_);
+  }
+  return false;
+}
+
+void FleetAggregator::Top(size_t n, vector<Entry>& out) const {
+  out.clear();
+  for (auto const& connection : connections_) {
+    for (FleetProcess const* process : connection.host->Top()) {
+      out.push_back(Entry{connection.host.get(), process});
+    }
+  }
+  n = std::min(n, out.size());
+  std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                    [](Entry const& a, Entry const& b) {
+                      return Busier(a.process, b.process);
+                    });
+  out.resize(n);
+}
+
+size_t FleetAggregator::Hosts() const { return connections_.size(); }
+
+size_t FleetAggregator::Processes() const {
+  size_t count = 0;
+  for (auto const& connection : connections_) {
+    count += connection.host->processes.size();
+  }
+  return count;
+}
+
+StringPool const& FleetAggregator::Strings() const { return strings_; }
+
+size_t FleetAggregator::Snapshots() const { return snapshots_; }
+
+size_t FleetAggregator::Bytes() const { return bytes_; }
+
+void FleetAggregator::ResetCounters() {
+  snapshots_ = 0;
+  bytes_ = 0;
+}
+
+void FleetAggregator::CompactStrings() {
+  StringPool strings;
+  for (auto& connection : connections_) {
+    connection.host->Reintern(strings_, strings);
+  }
+  strings_ = std::move(strings);
+}
@@ -0,0 +1,234 @@
+#include "fleet_protocol.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace FleetProtocol {
+
+FrameWriter::FrameWriter(vector<uint8_t>& out) : out_(out) {}
+
+void FrameWriter::Begin(uint8_t type) {
+  frame_start_ = out_.size();
+  out_.resize(out_.size() + kHeaderSize);
+  Byte(type);
+}
+
+void FrameWriter::End() {
+  size_t length = out_.size() - frame_start_ - kHeaderSize;
+  for (size_t i = 0; i < kHeaderSize; ++i) {
+    out_[frame_start_ + i] = (uint8_t)(length >> (8 * i));
+  }
+}
+
+void FrameWriter::Byte(uint8_t value) { out_.push_back(value); }
+
+void FrameWriter::Varint(uint64_t value) {
+  while (value >= 0x80) {
+    out_.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out_.push_back((uint8_t)value);
+}
+
+void FrameWriter::Signed(std::int64_t value) {
+  // Zigzag encode so that small negative deltas stay small
+  Varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void FrameWriter::Bytes(string_view value) {
+  Varint(value.size());
+  out_.insert(out_.end(), value.begin(), value.end());
+}
+
+FrameReader::FrameReader(uint8_t const* data, size_t size)
+    : data_(data), end_(data + size) {}
+
+uint8_t FrameReader::Byte() {
+  if (data_ == end_) {
+    ok_ = false;
+    return 0;
+  }
+  return *data_++;
+}
+
+uint64_t FrameReader::Varint() {
+  uint64_t value = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    if (data_ == end_) {
+      break;
+    }
+    uint8_t byte = *data_++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  ok_ = false;
+  return 0;
+}
+
+std::int64_t FrameReader::Signed() {
+  uint64_t value = Varint();
+  return (std::int64_t)(value >> 1) ^ -(std::int64_t)(value & 1);
+}
+
+string_view FrameReader::Bytes() {
+  uint64_t size = Varint();
+  if (!ok_ || size > (uint64_t)(end_ - data_)) {
+    ok_ = false;
+    return {};
+  }
+  string_view value((char const*)data_, size);
+  data_ += size;
+  return value;
+}
+
+bool FrameReader::Ok() const { return ok_; }
+
+bool FrameReader::Done() const { return data_ == end_; }
+
+void Encoder::Hello(string const& host, vector<uint8_t>& out) const {
+  FrameWriter writer(out);
+  writer.Begin(kHello);
+  writer.Bytes(host);
+  writer.Varint((uint64_t)sysconf(_SC_CLK_TCK));
+  writer.End();
+}
+
+void Encoder::Reset() { sent_.clear(); }
+
+void Encoder::Snapshot(SystemValues const& system,
+                       vector<Process> const& processes,
+                       StringPool const& strings, vector<uint8_t>& out) {
+  current_.clear();
+  for (auto const& process : processes) {
+    current_.push_back(
+        Sent{process.Values(),
+             std::llround(process.CpuUtilization() * kUtilizationScale)});
+  }
+  std::sort(current_.begin(), current_.end(), [](Sent const& a, Sent const& b) {
+    return a.values.pid < b.values.pid;
+  });
+
+  // One merge of the pid ordered current and sent lists finds every
+  // exited, new and changed process
+  exited_.clear();
+  born_.clear();
+  changed_.clear();
+  // After the pool is compacted an unchanged id may be a different string
+  bool renumbered = strings.Generation() != sent_generation_;
+  sent_generation_ = strings.Generation();
+  size_t sent = 0;
+  for (size_t current = 0; current < current_.size(); ++current) {
+    int pid = current_[current].values.pid;
+    while (sent < sent_.size() && sent_[sent].values.pid < pid) {
+      exited_.push_back(sent_[sent++].values.pid);
+    }
+    if (sent < sent_.size() && sent_[sent].values.pid == pid) {
+      // Unchanged processes cost nothing at all
+      uint8_t mask = Mask(current_[current], sent_[sent], renumbered);
+      if (mask != 0) {
+        changed_.push_back(Changed{current, sent, mask});
+      }
+      ++sent;
+    } else {
+      born_.push_back(current);
+    }
+  }
+  while (sent < sent_.size()) {
+    exited_.push_back(sent_[sent++].values.pid);
+  }
+
+  FrameWriter writer(out);
+  writer.Begin(kSnapshot);
+  writer.Varint(std::llround(system.uptime * 100.0));
+  writer.Varint(std::llround(system.cpu * kUtilizationScale));
+  writer.Varint(std::llround(system.memory * kUtilizationScale));
+  writer.Varint(system.running);
+  writer.Varint(system.total);
+
+  int previous_pid = 0;
+  writer.Varint(exited_.size());
+  for (int pid : exited_) {
+    writer.Varint(pid - previous_pid);
+    previous_pid = pid;
+  }
+
+  Sent const nothing{};
+  previous_pid = 0;
+  writer.Varint(born_.size());
+  for (size_t index : born_) {
+    Sent const& process = current_[index];
+    writer.Varint(process.values.pid - previous_pid);
+    previous_pid = process.values.pid;
+    Fields(writer, 0xff, process, nothing, strings);
+  }
+
+  previous_pid = 0;
+  writer.Varint(changed_.size());
+  for (auto const& changed : changed_) {
+    Sent const& current = current_[changed.current];
+    writer.Varint(current.values.pid - previous_pid);
+    previous_pid = current.values.pid;
+    writer.Byte(changed.mask);
+    Fields(writer, changed.mask, current, sent_[changed.previous], strings);
+  }
+  writer.End();
+
+  sent_.swap(current_);
+}
+
+uint8_t Encoder::Mask(Sent const& current, Sent const& previous,
+                      bool renumbered) {
+  LinuxParser::ProcessValues const& a = current.values;
+  LinuxParser::ProcessValues const& b = previous.values;
+  return (renumbered || a.user != b.user ? kUserBit : 0) |
+         (renumbered || a.command != b.command ? kCommandBit : 0) |
+         (a.vm_size != b.vm_size ? kVmSizeBit : 0) |
+         (a.vm_rss != b.vm_rss ? kVmRssBit : 0) |
+         (a.utime_ticks != b.utime_ticks ? kUtimeBit : 0) |
+         (a.stime_ticks != b.stime_ticks ? kStimeBit : 0) |
+         (a.starttime_ticks != b.starttime_ticks ? kStartTimeBit : 0) |
+         (current.cpu != previous.cpu ? kCpuBit : 0);
+}
+
+void Encoder::Fields(FrameWriter& writer, uint8_t mask, Sent const& current,
+                     Sent const& previous, StringPool const& strings) {
+  LinuxParser::ProcessValues const& a = current.values;
+  LinuxParser::ProcessValues const& b = previous.values;
+  if (mask & kUserBit) {
+    writer.Bytes(strings.View(a.user));
+  }
+  if (mask & kCommandBit) {
+    writer.Bytes(strings.View(a.command));
+  }
+  if (mask & kVmSizeBit) {
+    writer.Signed(a.vm_size - b.vm_size);
+  }
+  if (mask & kVmRssBit) {
+    writer.Signed(a.vm_rss - b.vm_rss);
+  }
+  if (mask & kUtimeBit) {
+    writer.Signed(a.utime_ticks - b.utime_ticks);
+  }
+  if (mask & kStimeBit) {
+    writer.Signed(a.stime_ticks - b.stime_ticks);
+  }
+  if (mask & kStartTimeBit) {
+    writer.Signed(a.starttime_ticks - b.starttime_ticks);
+  }
+  if (mask & kCpuBit) {
+    writer.Signed(current.cpu - previous.cpu);
+  }
+}
+
+}  // namespace FleetProtocol
@@ -1,4 +1,5 @@
 #include "format.h"
+#include <cstdio>
 #include <string>
 
 using std::string;
@@ -18,4 +19,17 @@ string Format::ElapsedTime(long seconds) {
   seconds -= minutes * 60;
   return FormatPart(hours) + ":" + FormatPart(minutes) + ":" +
          FormatPart(seconds);
-}
\ No newline at end of file
+}
+
+string Format::Bytes(double bytes) {
+  static char const units[] = {'B', 'K', 'M', 'G', 'T'};
+  int unit = 0;
+  while (bytes >= 1024.0 && unit < 4) {
+    bytes /= 1024.0;
+    ++unit;
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), unit == 0 ? "%.0f%c" : "%.1f%c", bytes,
+                units[unit]);
+  return text;
+}
@@ -0,0 +1,159 @@
+#include "history_query.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <ostream>
+#include <vector>
+
+#include "format.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+/**
+ * Format a time as a local date and time
+ * @param time
+ * @return
+ */
+static string LocalTime(long time) {
+  std::time_t seconds = time;
+  std::tm local{};
+  localtime_r(&seconds, &local);
+  char text[32];
+  std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+  return text;
+}
+
+/**
+ * Print the metrics of a row and its busiest processes
+ * @param row
+ * @param label
+ * @param top
+ * @param out
+ */
+static void PrintRow(HistoryRow const& row, string const& label, size_t top,
+                     std::ostream& out) {
+  auto const& cpu = row.metrics[(size_t)HistoryMetric::kCpu];
+  auto const& memory = row.metrics[(size_t)HistoryMetric::kMemory];
+  auto const& running = row.metrics[(size_t)HistoryMetric::kRunning];
+  auto const& processes = row.metrics[(size_t)HistoryMetric::kProcesses];
+  char text[160];
+  std::snprintf(text, sizeof(text),
+                "%s  cpu %5.1f%% (%5.1f-%5.1f)  mem %5.1f%% (%5.1f-%5.1f)  "
+                "running %4.1f (max %.0f)  procs %.0f",
+                label.c_str(), cpu.avg * 100, cpu.min * 100, cpu.max * 100,
+                memory.avg * 100, memory.min * 100, memory.max * 100,
+                running.avg, running.max, processes.avg);
+  out << text << "\n";
+  for (size_t i = 0; i < top && i < row.top.size(); ++i) {
+    TopProcess const& process = row.top[i];
+    std::snprintf(text, sizeof(text), "    %7d %-10.10s %6.1f%% %7s  ",
+                  process.pid, process.user.c_str(), process.cpu * 100,
+                  Format::Bytes(process.rss_kb * 1024.0).c_str());
+    out << text << process.command.substr(0, 80) << "\n";
+  }
+}
+
+bool HistoryQuery::ParseTime(string const& text, long now, long& time) {
+  if (text == "now") {
+    time = now;
+    return true;
+  }
+  char* end;
+  if (text.size() > 1 && text[0] == '-') {
+    long count = std::strtol(text.c_str() + 1, &end, 10);
+    static char const units[] = "smhd";
+    static long const seconds[] = {1, 60, 3600, 86400};
+    for (size_t unit = 0; unit < 4; ++unit) {
+      if (end[0] == units[unit] && end[1] == '\0' && count >= 0) {
+        time = now - count * seconds[unit];
+        return true;
+      }
+    }
+    return false;
+  }
+  long epoch = std::strtol(text.c_str(), &end, 10);
+  if (!text.empty() && *end == '\0') {
+    time = epoch;
+    return true;
+  }
+  std::tm local{};
+  char separator;
+  int matched =
+      std::sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%d", &local.tm_year,
+                  &local.tm_mon, &local.tm_mday, &separator, &local.tm_hour,
+                  &local.tm_min, &local.tm_sec);
+  if (matched != 3 && matched < 6) {
+    return false;
+  }
+  if (matched > 3 && separator != 'T' && separator != ' ') {
+    return false;
+  }
+  local.tm_year -= 1900;
+  local.tm_mon -= 1;
+  local.tm_isdst = -1;
+  time = std::mktime(&local);
+  return time != -1;
+}
+
+bool HistoryQuery::Run(string const& directory, string const& from,
+                       string const& to, string const& tier, size_t top,
+                       std::ostream& out, string& error) {
+  long now = std::time(nullptr);
+  long from_time;
+  long to_time;
+  if (!ParseTime(from, now, from_time) || !ParseTime(to, now, to_time)) {
+    error = "times must be now, seconds since the epoch, -<n>[smhd] or "
+            "YYYY-MM-DD[THH:MM[:SS]]";
+    return false;
+  }
+  if (to_time <= from_time) {
+    error = "the end of the range must come after its start";
+    return false;
+  }
+  size_t tier_index = HistoryStore::TierFor(from_time, to_time, now);
+  if (!tier.empty()) {
+    for (tier_index = 0; tier_index < HistoryStore::kTiers; ++tier_index) {
+      if (tier == HistoryStore::kTierNames[tier_index]) {
+        break;
+      }
+    }
+    if (tier_index == HistoryStore::kTiers) {
+      error = "tiers are 1s, 1m and 1h";
+      return false;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  vector<HistoryRow> rows;
+  if (!HistoryStore::Query(directory, tier_index, from_time, to_time, rows,
+                           error)) {
+    return false;
+  }
+  HistoryRow summary;
+  for (auto const& row : rows) {
+    HistoryStore::Merge(row, summary);
+  }
+  HistoryStore::Finish(summary);
+  double milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+
+  for (auto const& row : rows) {
+    PrintRow(row, LocalTime(row.time), top, out);
+  }
+  char text[160];
+  std::snprintf(text, sizeof(text),
+                "%zu %s rows from %s to %s in %.2f ms", rows.size(),
+                HistoryStore::kTierNames[tier_index],
+                LocalTime(from_time).c_str(), LocalTime(to_time).c_str(),
+                milliseconds);
+  out << text << "\n";
+  if (!rows.empty()) {
+    PrintRow(summary, "overall            ", HistoryStore::kTopK, out);
+  }
+  return true;
+}
@@ -0,0 +1,647 @@
+#include "history_store.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <unordered_map>
+
+#include "fleet_protocol.h"
+
+using FleetProtocol::FrameReader;
+using FleetProtocol::FrameWriter;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::uint8_t;
+using std::vector;
+
+/**
+ * Frame type of a block of rows
+ */
+static const uint8_t kBlock = 'B';
+
+/**
+ * Fixed point scale metrics and cpu use are stored with
+ */
+static const double kScale = 10000.0;
+
+/**
+ * Processes kept while a bucket is being merged, more than kTopK so that
+ * ones which are busy late in the bucket are not lost
+ */
+static const size_t kCandidates = 4 * HistoryStore::kTopK;
+
+/**
+ * An entry of a segment's index, locating one block
+ */
+struct IndexEntry {
+ public:
+  std::int64_t first{};
+  std::int64_t last{};
+  std::uint64_t offset{};
+  std::uint64_t size{};
+};
+
+/**
+ * Round time down to a multiple of length
+ * @param time
+ * @param length
+ * @return
+ */
+static long Floor(long time, long length) { return time - time % length; }
+
+/**
+ * The path of a tier's directory in the store
+ * @param directory
+ * @param tier
+ * @return
+ */
+static string TierPath(string const& directory, size_t tier) {
+  return directory + "/" + HistoryStore::kTierNames[tier];
+}
+
+/**
+ * The path of a segment's file with the provided extension
+ * @param directory
+ * @param tier
+ * @param segment
+ * @param extension
+ * @return
+ */
+static string SegmentPath(string const& directory, size_t tier, long segment,
+                          char const* extension) {
+  return TierPath(directory, tier) + "/" + std::to_string(segment) +
+         extension;
+}
+
+/**
+ * The start of every segment of a tier, by listing its directory. Returns
+ * false if the directory can not be read
+ * @param directory
+ * @param tier
+ * @param segments
+ * @return
+ */
+static bool Segments(string const& directory, size_t tier,
+                     vector<long>& segments) {
+  DIR* dir = opendir(TierPath(directory, tier).c_str());
+  if (dir == nullptr) {
+    return false;
+  }
+  while (dirent* entry = readdir(dir)) {
+    char* end;
+    long segment = std::strtol(entry->d_name, &end, 10);
+    if (end != entry->d_name && std::strcmp(end, ".seg") == 0) {
+      segments.push_back(segment);
+    }
+  }
+  closedir(dir);
+  std::sort(segments.begin(), segments.end());
+  return true;
+}
+
+/**
+ * Write the whole of data to fd. Returns false on failure
+ * @param fd
+ * @param data
+ * @param size
+ * @return
+ */
+static bool WriteAll(int fd, void const* data, size_t size) {
+  char const* next = (char const*)data;
+  while (size > 0) {
+    ssize_t written = write(fd, next, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    next += written;
+    size -= written;
+  }
+  return true;
+}
+
+/**
+ * Append a column of values delta coded from the one before
+ * @param writer
+ * @param rows
+ * @param value
+ */
+template <typename Value>
+static void DeltaColumn(FrameWriter& writer, vector<HistoryRow> const& rows,
+                        Value value) {
+  std::int64_t previous = 0;
+  for (auto const& row : rows) {
+    std::int64_t current = value(row);
+    writer.Signed(current - previous);
+    previous = current;
+  }
+}
+
+/**
+ * Append a column of a value of every top process of every row, delta
+ * coded from the one before
+ * @param writer
+ * @param rows
+ * @param value
+ */
+template <typename Value>
+static void TopColumn(FrameWriter& writer, vector<HistoryRow> const& rows,
+                      Value value) {
+  std::int64_t previous = 0;
+  for (auto const& row : rows) {
+    for (auto const& process : row.top) {
+      std::int64_t current = value(process);
+      writer.Signed(current - previous);
+      previous = current;
+    }
+  }
+}
+
+/**
+ * Encode rows as a block frame appended to out
+ * @param rows
+ * @param out
+ */
+static void EncodeBlock(vector<HistoryRow> const& rows, vector<uint8_t>& out) {
+  // Commands and users repeat from row to row, so each is written once
+  std::unordered_map<string_view, size_t> indexes;
+  vector<string_view> dictionary;
+  auto index = [&](string const& value) {
+    auto [entry, added] = indexes.emplace(value, dictionary.size());
+    if (added) {
+      dictionary.push_back(value);
+    }
+    return (std::int64_t)entry->second;
+  };
+  vector<std::int64_t> users;
+  vector<std::int64_t> commands;
+  for (auto const& row : rows) {
+    for (auto const& process : row.top) {
+      users.push_back(index(process.user));
+      commands.push_back(index(process.command));
+    }
+  }
+
+  FrameWriter writer(out);
+  writer.Begin(kBlock);
+  writer.Varint(rows.size());
+  writer.Varint(dictionary.size());
+  for (string_view value : dictionary) {
+    writer.Bytes(value);
+  }
+  DeltaColumn(writer, rows, [](HistoryRow const& row) { return row.time; });
+  DeltaColumn(writer, rows,
+              [](HistoryRow const& row) { return row.samples; });
+  for (size_t metric = 0; metric < kHistoryMetrics; ++metric) {
+    for (double MetricSummary::*field :
+         {&MetricSummary::min, &MetricSummary::max, &MetricSummary::avg}) {
+      DeltaColumn(writer, rows, [&](HistoryRow const& row) {
+        return std::llround(row.metrics[metric].*field * kScale);
+      });
+    }
+  }
+  DeltaColumn(writer, rows,
+              [](HistoryRow const& row) { return (long)row.top.size(); });
+  TopColumn(writer, rows, [](TopProcess const& process) {
+    return (std::int64_t)process.pid;
+  });
+  TopColumn(writer, rows, [](TopProcess const& process) {
+    return std::llround(process.cpu * kScale);
+  });
+  TopColumn(writer, rows,
+            [](TopProcess const& process) { return process.rss_kb; });
+  for (auto values : {&users, &commands}) {
+    std::int64_t previous = 0;
+    for (std::int64_t value : *values) {
+      writer.Signed(value - previous);
+      previous = value;
+    }
+  }
+  writer.End();
+}
+
+/**
+ * Decode the rows of a block frame's payload, appending them to rows.
+ * Returns false if the block is malformed
+ * @param reader
+ * @param rows
+ * @return
+ */
+static bool DecodeBlock(FrameReader& reader, vector<HistoryRow>& rows) {
+  if (reader.Byte() != kBlock) {
+    return false;
+  }
+  size_t count = reader.Varint();
+  size_t words = reader.Varint();
+  if (!reader.Ok() || count > (1u << 20) || words > (1u << 20)) {
+    return false;
+  }
+  vector<string_view> dictionary(words);
+  for (auto& word : dictionary) {
+    word = reader.Bytes();
+  }
+  size_t first = rows.size();
+  rows.resize(first + count);
+  auto column = [&](auto assign) {
+    std::int64_t value = 0;
+    for (size_t i = first; i < rows.size(); ++i) {
+      value += reader.Signed();
+      assign(rows[i], value);
+    }
+  };
+  column([](HistoryRow& row, std::int64_t value) { row.time = value; });
+  column([](HistoryRow& row, std::int64_t value) { row.samples = value; });
+  for (size_t metric = 0; metric < kHistoryMetrics; ++metric) {
+    for (double MetricSummary::*field :
+         {&MetricSummary::min, &MetricSummary::max, &MetricSummary::avg}) {
+      column([&](HistoryRow& row, std::int64_t value) {
+        row.metrics[metric].*field = (double)value / kScale;
+      });
+    }
+  }
+  column([](HistoryRow& row, std::int64_t value) {
+    row.top.resize(std::clamp<std::int64_t>(value, 0, kCandidates));
+  });
+  auto top_column = [&](auto assign) {
+    std::int64_t value = 0;
+    for (size_t i = first; i < rows.size(); ++i) {
+      for (auto& process : rows[i].top) {
+        value += reader.Signed();
+        assign(process, value);
+      }
+    }
+  };
+  top_column([](TopProcess& process, std::int64_t value) {
+    process.pid = (int)value;
+  });
+  top_column([](TopProcess& process, std::int64_t value) {
+    process.cpu = (double)value / kScale;
+  });
+  top_column([](TopProcess& process, std::int64_t value) {
+    process.rss_kb = value;
+  });
+  for (string TopProcess::*field : {&TopProcess::user, &TopProcess::command}) {
+    top_column([&](TopProcess& process, std::int64_t value) {
+      if (value >= 0 && (size_t)value < dictionary.size()) {
+        process.*field = dictionary[value];
+      }
+    });
+  }
+  if (!reader.Ok()) {
+    rows.resize(first);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Read the whole of the file at path into buffer. Returns false if it can
+ * not be read
+ * @param path
+ * @param buffer
+ * @return
+ */
+static bool ReadAll(string const& path, vector<uint8_t>& buffer) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0;
+  buffer.resize(ok ? info.st_size : 0);
+  ok = ok && pread(fd, buffer.data(), buffer.size(), 0) == info.st_size;
+  close(fd);
+  return ok;
+}
+
+HistoryStore::~HistoryStore() { Close(); }
+
+bool HistoryStore::Open(string const& directory, string& error) {
+  Close();
+  for (size_t tier = 0; tier <= kTiers; ++tier) {
+    string path = tier == 0 ? directory : TierPath(directory, tier - 1);
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+      error = "can not create " + path + ": " + std::strerror(errno);
+      return false;
+    }
+  }
+  directory_ = directory;
+  for (size_t tier = 0; tier < kTiers; ++tier) {
+    Expire(tier, std::time(nullptr));
+  }
+  return true;
+}
+
+bool HistoryStore::IsOpen() const { return !directory_.empty(); }
+
+void HistoryStore::Close() {
+  if (!IsOpen()) {
+    return;
+  }
+  // Incomplete buckets are written as they are. A restart in the same
+  // bucket writes it again, and queries merge the two
+  for (size_t tier = 0; tier < kTiers; ++tier) {
+    if (tiers_[tier].bucket.samples > 0) {
+      Complete(tier);
+    }
+    Flush(tier);
+  }
+  tiers_ = {};
+  flushed_ = -1;
+  directory_.clear();
+}
+
+void HistoryStore::Record(double cpu, double memory, int running,
+                          vector<Process> const& processes,
+                          StringPool const& strings) {
+  if (!IsOpen()) {
+    return;
+  }
+  HistoryRow sample;
+  sample.time = std::time(nullptr);
+  sample.samples = 1;
+  double values[kHistoryMetrics];
+  values[(size_t)HistoryMetric::kCpu] = cpu;
+  values[(size_t)HistoryMetric::kMemory] = memory;
+  values[(size_t)HistoryMetric::kRunning] = running;
+  values[(size_t)HistoryMetric::kProcesses] = (double)processes.size();
+  for (size_t metric = 0; metric < kHistoryMetrics; ++metric) {
+    sample.metrics[metric] = {values[metric], values[metric], values[metric]};
+  }
+
+  busiest_.clear();
+  for (Process const& process : processes) {
+    busiest_.push_back(&process);
+  }
+  size_t kept = std::min(busiest_.size(), kCandidates);
+  std::partial_sort(busiest_.begin(), busiest_.begin() + kept, busiest_.end(),
+                    [](Process const* a, Process const* b) {
+                      return a->CpuUtilization() > b->CpuUtilization();
+                    });
+  busiest_.resize(kept);
+  for (Process const* process : busiest_) {
+    ProcessValues const& values = process->Values();
+    sample.top.push_back({values.pid, string(strings.View(values.user)),
+                          string(strings.View(values.command)
+                                     .substr(0, kCommandLength)),
+                          process->CpuUtilization(), process->RssKb()});
+  }
+  Add(sample);
+}
+
+void HistoryStore::Add(HistoryRow const& sample) {
+  Tier& first = tiers_[0];
+  long time = Floor(sample.time, kResolutions[0]);
+  if (first.bucket.samples > 0 && first.bucket.time != time) {
+    Complete(0);
+  }
+  first.bucket.time = time;
+  Merge(sample, first.bucket);
+  // Completed buckets are written at every minute boundary, in blocks
+  // shorter than kBlockRows if need be, so a monitor which is killed loses
+  // at most the last minute. The first sample of a minute completes the
+  // longer buckets which ended before it, rather than leaving them open
+  // until its own second completes
+  long minute = Floor(time, kResolutions[1]);
+  if (minute != flushed_) {
+    for (size_t tier = 1; tier < kTiers; ++tier) {
+      HistoryRow const& bucket = tiers_[tier].bucket;
+      if (bucket.samples > 0 &&
+          bucket.time != Floor(time, kResolutions[tier])) {
+        Complete(tier);
+      }
+    }
+    for (size_t tier = 0; tier < kTiers; ++tier) {
+      Flush(tier);
+    }
+    flushed_ = minute;
+  }
+}
+
+void HistoryStore::Complete(size_t tier) {
+  Tier& current = tiers_[tier];
+  // Every candidate is merged upward before the bucket is trimmed to
+  // kTopK, so a process which is often just outside the busiest of each
+  // short bucket still counts towards the longer one
+  if (tier + 1 < kTiers) {
+    Tier& next = tiers_[tier + 1];
+    long time = Floor(current.bucket.time, kResolutions[tier + 1]);
+    if (next.bucket.samples > 0 && next.bucket.time != time) {
+      Complete(tier + 1);
+    }
+    next.bucket.time = time;
+    Merge(current.bucket, next.bucket);
+  }
+  Finish(current.bucket);
+  if (!current.pending.empty() &&
+      Floor(current.pending.front().time, kSegmentSpans[tier]) !=
+          Floor(current.bucket.time, kSegmentSpans[tier])) {
+    Flush(tier);
+  }
+  current.pending.push_back(std::move(current.bucket));
+  current.bucket = HistoryRow{};
+  if (current.pending.size() >= kBlockRows[tier]) {
+    Flush(tier);
+  }
+}
+
+void HistoryStore::Flush(size_t tier) {
+  Tier& current = tiers_[tier];
+  if (current.pending.empty()) {
+    return;
+  }
+  long segment = Floor(current.pending.front().time, kSegmentSpans[tier]);
+  if (segment != current.segment) {
+    current.segment = segment;
+    Expire(tier, current.pending.back().time);
+  }
+  out_.clear();
+  EncodeBlock(current.pending, out_);
+
+  // Blocks are written before the index entry which points at them, so an
+  // interrupted write leaves at worst an unreachable block
+  int fd = open(SegmentPath(directory_, tier, segment, ".seg").c_str(),
+                O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  struct stat info;
+  if (fd >= 0 && fstat(fd, &info) == 0 &&
+      WriteAll(fd, out_.data(), out_.size())) {
+    IndexEntry entry;
+    entry.first = current.pending.front().time;
+    entry.last = current.pending.back().time;
+    entry.offset = info.st_size;
+    entry.size = out_.size();
+    int index = open(SegmentPath(directory_, tier, segment, ".idx").c_str(),
+                     O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (index >= 0) {
+      WriteAll(index, &entry, sizeof(entry));
+      close(index);
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  current.pending.clear();
+}
+
+void HistoryStore::Expire(size_t tier, long now) const {
+  vector<long> segments;
+  Segments(directory_, tier, segments);
+  for (long segment : segments) {
+    if (segment + kSegmentSpans[tier] > now - kRetentions[tier]) {
+      break;
+    }
+    unlink(SegmentPath(directory_, tier, segment, ".idx").c_str());
+    unlink(SegmentPath(directory_, tier, segment, ".seg").c_str());
+  }
+}
+
+bool HistoryStore::Query(string const& directory, size_t tier, long from,
+                         long to, vector<HistoryRow>& rows, string& error) {
+  rows.clear();
+  vector<long> segments;
+  if (tier >= kTiers || !Segments(directory, tier, segments)) {
+    error = "can not read " + TierPath(directory, std::min(tier, kTiers - 1));
+    return false;
+  }
+  vector<uint8_t> index;
+  vector<uint8_t> block;
+  for (long segment : segments) {
+    if (segment >= to || segment + kSegmentSpans[tier] <= from ||
+        !ReadAll(SegmentPath(directory, tier, segment, ".idx"), index)) {
+      continue;
+    }
+    vector<IndexEntry> entries(index.size() / sizeof(IndexEntry));
+    std::memcpy(entries.data(), index.data(),
+                entries.size() * sizeof(IndexEntry));
+    // Blocks are appended in time order, so skip straight to the first one
+    // which can hold from
+    auto entry = std::partition_point(
+        entries.begin(), entries.end(),
+        [from](IndexEntry const& entry) { return entry.last < from; });
+    int fd = open(SegmentPath(directory, tier, segment, ".seg").c_str(),
+                  O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    for (; entry != entries.end() && entry->first < to; ++entry) {
+      block.resize(entry->size);
+      if (entry->size <= FleetProtocol::kHeaderSize ||
+          pread(fd, block.data(), block.size(), entry->offset) !=
+              (ssize_t)block.size()) {
+        continue;
+      }
+      FrameReader reader(block.data() + FleetProtocol::kHeaderSize,
+                         block.size() - FleetProtocol::kHeaderSize);
+      size_t first = rows.size();
+      DecodeBlock(reader, rows);
+      rows.erase(std::remove_if(rows.begin() + first, rows.end(),
+                                [from, to](HistoryRow const& row) {
+                                  return row.time < from || row.time >= to;
+                                }),
+                 rows.end());
+    }
+    close(fd);
+  }
+
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](HistoryRow const& a, HistoryRow const& b) {
+                     return a.time < b.time;
+                   });
+  size_t kept = 0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (kept > 0 && rows[kept - 1].time == rows[i].time) {
+      HistoryRow merged;
+      merged.time = rows[i].time;
+      Merge(rows[kept - 1], merged);
+      Merge(rows[i], merged);
+      Finish(merged);
+      rows[kept - 1] = std::move(merged);
+    } else if (kept++ != i) {
+      rows[kept - 1] = std::move(rows[i]);
+    }
+  }
+  rows.resize(kept);
+  return true;
+}
+
+size_t HistoryStore::TierFor(long from, long to, long now) {
+  for (size_t tier = 0; tier + 1 < kTiers; ++tier) {
+    if (from >= now - kRetentions[tier] &&
+        (to - from) / kResolutions[tier] <= kMaxQueryRows) {
+      return tier;
+    }
+  }
+  return kTiers - 1;
+}
+
+void HistoryStore::Merge(HistoryRow const& row, HistoryRow& bucket) {
+  if (row.samples <= 0) {
+    return;
+  }
+  long samples = bucket.samples + row.samples;
+  double kept = (double)bucket.samples / samples;
+  double added = (double)row.samples / samples;
+  for (size_t metric = 0; metric < kHistoryMetrics; ++metric) {
+    MetricSummary const& from = row.metrics[metric];
+    MetricSummary& into = bucket.metrics[metric];
+    if (bucket.samples == 0) {
+      into = from;
+      continue;
+    }
+    into.min = std::min(into.min, from.min);
+    into.max = std::max(into.max, from.max);
+    into.avg = into.avg * kept + from.avg * added;
+  }
+
+  // A process missing from either side was not among the busiest there
+  for (auto& process : bucket.top) {
+    process.cpu *= kept;
+  }
+  size_t merged = bucket.top.size();
+  for (auto const& process : row.top) {
+    auto same = std::find_if(
+        bucket.top.begin(), bucket.top.begin() + merged,
+        [&](TopProcess const& other) {
+          return other.pid == process.pid && other.command == process.command;
+        });
+    if (same != bucket.top.begin() + merged) {
+      same->cpu += process.cpu * added;
+      same->rss_kb = std::max(same->rss_kb, process.rss_kb);
+    } else {
+      bucket.top.push_back(process);
+      bucket.top.back().cpu *= added;
+    }
+  }
+  bucket.samples = samples;
+
+  if (bucket.top.size() > 2 * kCandidates) {
+    auto busier = [](TopProcess const& a, TopProcess const& b) {
+      return a.cpu > b.cpu;
+    };
+    std::nth_element(bucket.top.begin(), bucket.top.begin() + kCandidates,
+                     bucket.top.end(), busier);
+    bucket.top.resize(kCandidates);
+  }
+}
+
+void HistoryStore::Finish(HistoryRow& bucket) {
+  auto busier = [](TopProcess const& a, TopProcess const& b) {
+    return a.cpu > b.cpu || (a.cpu == b.cpu && a.pid < b.pid);
+  };
+  std::sort(bucket.top.begin(), bucket.top.end(), busier);
+  if (bucket.top.size() > kTopK) {
+    bucket.top.resize(kTopK);
+  }
+}
@@ -1,16 +1,27 @@
 #include "linux_parser.h"
 
 #include <dirent.h>
-
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using std::istringstream;
 using std::map;
 using std::stof;
 using std::string;
+using std::string_view;
 using std::to_string;
 using std::vector;
 
@@ -20,21 +31,20 @@ using std::vector;
 static const unsigned int kUtime = 13;
 static const unsigned int kStime = 14;
 static const unsigned int kStartTime = 21;
+static const unsigned int kProcessor = 38;
 
 /**
- * Split the provided string into parts delimited by a given delimiter
- * @param str
- * @param delim
- * @return
+ * Size of the buffer /proc is listed into
  */
-vector<string> SplitString(const string &str, char delim);
+static const std::size_t kDirentBufferSize = 64 * 1024;
 
 /**
- * Split the provided string into parts
+ * Split the provided string into parts delimited by a given delimiter
  * @param str
+ * @param delim
  * @return
  */
-vector<string> SplitLine(const string &str);
+vector<string> SplitString(const string &str, char delim);
 
 /**
  * Collect the desired process count value
@@ -64,27 +74,60 @@ void ProcessFileLines(const string &path,
 long StoLSafe(const string &from);
 
 /**
- * Read and return the command associated with a process
+ * Read the whole of the file at path into the provided buffer with a single
+ * open and as few reads as possible. The buffer keeps its capacity between
+ * calls so that steady state reads do not allocate.
+ * Returns false, leaving the buffer empty, if the file could not be opened
  * @param path
+ * @param buffer
  * @return
  */
-string ReadCommandFile(const string &path);
+bool ReadFile(const string &path, string &buffer);
 
 /**
- * Parse desired values from a process stat file into the provided ProcessValues
- * @param path
+ * Remove and return the next line of the provided text
+ * @param text
+ * @return
+ */
+string_view NextLine(string_view &text);
+
+/**
+ * Remove and return the next whitespace delimited field of the provided text
+ * @param text
+ * @return
+ */
+string_view NextField(string_view &text);
+
+/**
+ * Convert from string_view to long, returning 0 if it is not a number
+ * @param from
+ * @return
+ */
+long ParseLong(string_view from);
+
+/**
+ * Parse desired values from the contents of a process stat file into the
+ * provided ProcessValues
+ * @param contents
  * @param values
  */
-void ParseProcStatFile(const string &path, LinuxParser::ProcessValues &values);
+void ParseProcStat(string_view contents, LinuxParser::ProcessValues &values);
 
 /**
- * Read desired values from a processes status file into the provided
- * ProcessValues
- * @param path
+ * Parse desired values from the contents of a process status file into the
+ * provided ProcessValues
+ * @param contents
  * @param values
  */
-void ParseProcStatusFile(const string &path,
-                         LinuxParser::ProcessValues &values);
+void ParseProcStatus(string_view contents, LinuxParser::ProcessValues &values);
+
+/**
+ * Turn the contents of a process cmdline file, in which arguments are
+ * separated by NUL characters, into a single space separated line
+ * @param contents
+ * @return
+ */
+string_view CommandLine(string &contents);
 
 vector<string> SplitString(const string &str, char delim) {
   vector<string> result{};
@@ -96,16 +139,6 @@ vector<string> SplitString(const string &str, char delim) {
   return result;
 }
 
-vector<string> SplitLine(const string &str) {
-  vector<string> result{};
-  string part;
-  std::stringstream source(str);
-  while (source >> part) {
-    result.push_back(part);
-  }
-  return result;
-}
-
 int ProcessCount(const string &file_path, const string &desired_key) {
   int value;
   auto line_processor = [&](istringstream &line_stream) -> bool {
@@ -184,22 +217,58 @@ string LinuxParser::Kernel() {
 }
 
 vector<int> LinuxParser::Pids() {
-  vector<int> pids;
-  DIR *directory = opendir(kProcDirectory.c_str());
-  struct dirent *file;
-  while ((file = readdir(directory)) != nullptr) {
-    // Is this a directory?
-    if (file->d_type == DT_DIR) {
-      // Is every character of the name a digit?
-      string filename(file->d_name);
-      if (std::all_of(filename.begin(), filename.end(), isdigit)) {
-        int pid = stoi(filename);
+  std::pmr::vector<int> pids(std::pmr::new_delete_resource());
+  Pids(pids);
+  return vector<int>(pids.begin(), pids.end());
+}
+
+/**
+ * Layout of the records getdents64 fills its buffer with
+ */
+struct LinuxDirent64 {
+  std::uint64_t d_ino;
+  std::int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+void LinuxParser::Pids(std::pmr::vector<int> &pids,
+                       std::string const &directory) {
+  pids.clear();
+  int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  // Each call fills the buffer with as many entries as fit, so /proc is
+  // listed in a handful of calls without a copy per entry
+  std::pmr::memory_resource *resource = pids.get_allocator().resource();
+  char *buffer = (char *)resource->allocate(kDirentBufferSize,
+                                            alignof(LinuxDirent64));
+  while (true) {
+    long count = syscall(SYS_getdents64, fd, buffer, kDirentBufferSize);
+    if (count <= 0) {
+      break;
+    }
+    for (long offset = 0; offset < count;) {
+      auto *entry = (LinuxDirent64 *)(buffer + offset);
+      offset += entry->d_reclen;
+      if (entry->d_type != DT_DIR) {
+        continue;
+      }
+      // Only directories named entirely with digits are processes
+      int pid = 0;
+      const char *name = entry->d_name;
+      for (; *name >= '0' && *name <= '9'; ++name) {
+        pid = pid * 10 + (*name - '0');
+      }
+      if (*name == '\0' && name != entry->d_name) {
         pids.push_back(pid);
       }
     }
   }
-  closedir(directory);
-  return pids;
+  resource->deallocate(buffer, kDirentBufferSize, alignof(LinuxDirent64));
+  close(fd);
 }
 
 void LinuxParser::MemoryUtilization(MemoryValues &values) {
@@ -217,14 +286,133 @@ void LinuxParser::MemoryUtilization(MemoryValues &values) {
   ProcessFileLines(kProcDirectory + kMeminfoFilename, line_processor);
 }
 
-long LinuxParser::UpTime() {
-  double uptime, idle_time;
+bool LinuxParser::Pressure(const string &filename, PressureValues &values) {
+  bool found = false;
+  auto line_processor = [&](istringstream &line_stream) -> bool {
+    string kind, avg10, avg60, avg300, total;
+    line_stream >> kind >> avg10 >> avg60 >> avg300 >> total;
+    StallValues *stall = kind == "some"   ? &values.some
+                         : kind == "full" ? &values.full
+                                          : nullptr;
+    if (stall == nullptr) {
+      return true;
+    }
+    // Each value is written as key=value
+    auto value = [](const string &pair) {
+      return pair.substr(std::min(pair.find('=') + 1, pair.size()));
+    };
+    stall->avg10 = std::strtof(value(avg10).c_str(), nullptr);
+    stall->avg60 = std::strtof(value(avg60).c_str(), nullptr);
+    stall->avg300 = std::strtof(value(avg300).c_str(), nullptr);
+    stall->total_us = StoLSafe(value(total));
+    found = true;
+    return true;
+  };
+  ProcessFileLines(kPressureDirectory + filename, line_processor);
+  return found;
+}
+
+/**
+ * Copy a device name into a fixed size name field, truncating it if needed
+ * @param from
+ * @param name
+ */
+static void CopyName(string_view from, char (&name)[LinuxParser::kDeviceNameSize]) {
+  std::size_t size = std::min(from.size(), LinuxParser::kDeviceNameSize - 1);
+  std::memcpy(name, from.data(), size);
+  name[size] = '\0';
+}
+
+bool LinuxParser::NetworkDevices(string &buffer, NetworkValues &values) {
+  values.count = 0;
+  if (!ReadFile(kNetDevPath, buffer)) {
+    return false;
+  }
+  string_view contents{buffer};
+  // Skip the two header lines
+  NextLine(contents);
+  NextLine(contents);
+  while (!contents.empty() && values.count < kMaxDevices) {
+    string_view line = NextLine(contents);
+    // Counters may directly follow the colon after the name
+    std::size_t colon = line.find(':');
+    if (colon == string_view::npos) {
+      continue;
+    }
+    string_view name = line.substr(0, colon);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    line.remove_prefix(colon + 1);
+    InterfaceValues &interface = values.interfaces[values.count++];
+    CopyName(name, interface.name);
+    interface.rx_bytes = ParseLong(NextField(line));
+    interface.rx_packets = ParseLong(NextField(line));
+    // Skip errs, drop, fifo, frame, compressed and multicast
+    for (int i = 0; i < 6; ++i) {
+      NextField(line);
+    }
+    interface.tx_bytes = ParseLong(NextField(line));
+    interface.tx_packets = ParseLong(NextField(line));
+  }
+  return true;
+}
+
+bool LinuxParser::DiskStats(string &buffer, DiskStatsValues &values) {
+  values.count = 0;
+  if (!ReadFile(kDiskStatsPath, buffer)) {
+    return false;
+  }
+  string_view contents{buffer};
+  while (!contents.empty() && values.count < kMaxDevices) {
+    string_view line = NextLine(contents);
+    NextField(line);  // major
+    NextField(line);  // minor
+    string_view name = NextField(line);
+    if (name.empty()) {
+      continue;
+    }
+    DiskValues &disk = values.disks[values.count++];
+    CopyName(name, disk.name);
+    disk.reads = ParseLong(NextField(line));
+    NextField(line);  // reads merged
+    disk.sectors_read = ParseLong(NextField(line));
+    NextField(line);  // ms reading
+    disk.writes = ParseLong(NextField(line));
+    NextField(line);  // writes merged
+    disk.sectors_written = ParseLong(NextField(line));
+    NextField(line);  // ms writing
+    NextField(line);  // in flight
+    disk.io_ms = ParseLong(NextField(line));
+  }
+  return true;
+}
+
+long LinuxParser::SelfResidentKb() {
+  long size{}, resident{};
   auto line_processor = [&](istringstream &line_stream) -> bool {
-    line_stream >> uptime >> idle_time;
-    return false;  // done after the first line
+    line_stream >> size >> resident;
+    return false;  // there is only one line
   };
-  ProcessFileLines(kProcDirectory + kUptimeFilename, line_processor);
-  return (long)uptime;
+  ProcessFileLines(kSelfStatmPath, line_processor);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+long LinuxParser::UpTime() { return (long)PreciseUpTime(); }
+
+double LinuxParser::PreciseUpTime() {
+  // Read every refresh, so this avoids the allocations of a stream
+  static const string path = kProcDirectory + kUptimeFilename;
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  char text[64];
+  ssize_t count = read(fd, text, sizeof(text) - 1);
+  close(fd);
+  if (count <= 0) {
+    return 0;
+  }
+  text[count] = '\0';
+  return std::strtod(text, nullptr);
 }
 
 void LinuxParser::CpuUtilization(CPUValues &values) {
@@ -238,6 +426,174 @@ void LinuxParser::CpuUtilization(CPUValues &values) {
   ProcessFileLines(kProcDirectory + kStatFilename, line_processor);
 }
 
+void LinuxParser::CoreUtilizations(string &buffer,
+                                   vector<CPUValues> &values) {
+  for (auto &cpu : values) {
+    cpu = CPUValues{};
+  }
+  if (!ReadFile(kProcDirectory + kStatFilename, buffer)) {
+    return;
+  }
+  string_view contents{buffer};
+  // The aggregated line comes first, followed by one line per online cpu
+  NextLine(contents);
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    string_view name = NextField(line);
+    if (name.size() < 4 || name.substr(0, 3) != "cpu") {
+      break;
+    }
+    std::size_t cpu = (std::size_t)ParseLong(name.substr(3));
+    if (cpu >= values.size()) {
+      values.resize(cpu + 1);
+    }
+    CPUValues &cpu_values = values[cpu];
+    for (long *value : {&cpu_values.user, &cpu_values.nice, &cpu_values.system,
+                        &cpu_values.idle, &cpu_values.io_wait, &cpu_values.irq,
+                        &cpu_values.soft_irq, &cpu_values.steal,
+                        &cpu_values.guest, &cpu_values.guest_nice}) {
+      *value = ParseLong(NextField(line));
+    }
+  }
+}
+
+void LinuxParser::Load(string &buffer, LoadValues &values) {
+  static const string stat_path = kProcDirectory + kStatFilename;
+  static const string meminfo_path = kProcDirectory + kMeminfoFilename;
+  values = LoadValues{};
+  if (ReadFile(stat_path, buffer)) {
+    string_view contents{buffer};
+    // The aggregated cpu line comes first
+    string_view line = NextLine(contents);
+    NextField(line);
+    CPUValues &cpu = values.cpu;
+    for (long *value : {&cpu.user, &cpu.nice, &cpu.system, &cpu.idle,
+                        &cpu.io_wait, &cpu.irq, &cpu.soft_irq, &cpu.steal,
+                        &cpu.guest, &cpu.guest_nice}) {
+      *value = ParseLong(NextField(line));
+    }
+    while (!contents.empty()) {
+      line = NextLine(contents);
+      string_view key = NextField(line);
+      if (key == "processes") {
+        values.total = (int)ParseLong(NextField(line));
+      } else if (key == "procs_running") {
+        values.running = (int)ParseLong(NextField(line));
+      }
+    }
+  }
+  if (ReadFile(meminfo_path, buffer)) {
+    string_view contents{buffer};
+    while (!contents.empty() && (values.memory.total == 0 ||
+                                 values.memory.free == 0)) {
+      string_view line = NextLine(contents);
+      string_view key = NextField(line);
+      if (key.size() > 1 && key.back() == ':') {
+        key.remove_suffix(1);
+        if (key == kMemTotal) {
+          values.memory.total = ParseLong(NextField(line));
+        } else if (key == kMemFree) {
+          values.memory.free = ParseLong(NextField(line));
+        }
+      }
+    }
+  }
+}
+
+void LinuxParser::ParseCpuList(string_view list, vector<int> &cpus) {
+  while (!list.empty()) {
+    std::size_t comma = std::min(list.find(','), list.size());
+    string_view range = list.substr(0, comma);
+    list.remove_prefix(std::min(comma + 1, list.size()));
+    if (range.empty()) {
+      continue;
+    }
+    std::size_t dash = range.find('-');
+    int first = (int)ParseLong(range.substr(0, dash));
+    int last = dash == string_view::npos ? first
+                                         : (int)ParseLong(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+}
+
+void LinuxParser::NumaNodes(vector<NumaNodeValues> &nodes) {
+  nodes.clear();
+  DIR *directory = opendir(kNodeDirectory.c_str());
+  if (directory == nullptr) {
+    return;
+  }
+  string buffer;
+  struct dirent *file;
+  while ((file = readdir(directory)) != nullptr) {
+    string_view name{file->d_name};
+    if (name.size() < 5 || name.substr(0, 4) != "node" ||
+        !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+      continue;
+    }
+    NumaNodeValues node{};
+    node.id = (int)ParseLong(name.substr(4));
+    if (ReadFile(kNodeDirectory + file->d_name + kCpuListFilename, buffer)) {
+      string_view contents{buffer};
+      ParseCpuList(NextLine(contents), node.cpus);
+    }
+    nodes.push_back(std::move(node));
+  }
+  closedir(directory);
+  std::sort(nodes.begin(), nodes.end(),
+            [](NumaNodeValues const &a, NumaNodeValues const &b) {
+              return a.id < b.id;
+            });
+}
+
+bool LinuxParser::ProcessPlacement(int pid, PlacementValues &values) {
+  values.cpus_allowed.clear();
+  values.node_kb.clear();
+  string path;
+  string buffer;
+  ProcPath(path, pid, kStatusFilename);
+  if (!ReadFile(path, buffer)) {
+    return false;
+  }
+  string_view contents{buffer};
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    if (NextField(line) == "Cpus_allowed_list:") {
+      values.cpus_allowed = string(NextField(line));
+      break;
+    }
+  }
+
+  // Each mapping lists its pages on each node as N<node>=<pages>, in pages
+  // of kernelpagesize_kB
+  ProcPath(path, pid, kNumaMapsFilename);
+  ReadFile(path, buffer);
+  contents = buffer;
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    long page_kb = 4;
+    std::size_t page_size = line.find("kernelpagesize_kB=");
+    if (page_size != string_view::npos) {
+      string_view rest = line.substr(page_size + 18);
+      page_kb = ParseLong(NextField(rest));
+    }
+    for (string_view field = NextField(line); !field.empty();
+         field = NextField(line)) {
+      std::size_t equals = field.find('=');
+      if (field[0] != 'N' || equals == string_view::npos) {
+        continue;
+      }
+      std::size_t node = (std::size_t)ParseLong(field.substr(1, equals - 1));
+      if (node >= values.node_kb.size()) {
+        values.node_kb.resize(node + 1);
+      }
+      values.node_kb[node] += ParseLong(field.substr(equals + 1)) * page_kb;
+    }
+  }
+  return true;
+}
+
 int LinuxParser::TotalProcesses() {
   return ProcessCount(kProcDirectory + kStatFilename, "processes");
 }
@@ -254,61 +610,227 @@ long StoLSafe(const string &from) {
   }
 }
 
-void ParseProcStatusFile(const string &path,
-                         LinuxParser::ProcessValues &values) {
-  auto line_processor = [&](istringstream &line_stream) -> bool {
-    string key, value;
-    line_stream >> key >> value;
+bool ReadFile(const string &path, string &buffer) {
+  buffer.clear();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  std::size_t used = 0;
+  buffer.resize(std::max(buffer.capacity(), (std::size_t)4096));
+  while (true) {
+    ssize_t count = read(fd, &buffer[used], buffer.size() - used);
+    if (count <= 0) {
+      break;
+    }
+    used += count;
+    if (used == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+  }
+  close(fd);
+  buffer.resize(used);
+  return true;
+}
+
+string_view NextLine(string_view &text) {
+  std::size_t end = text.find('\n');
+  string_view line = text.substr(0, end);
+  text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+  return line;
+}
+
+string_view NextField(string_view &text) {
+  std::size_t start = text.find_first_not_of(" \t");
+  if (start == string_view::npos) {
+    text = {};
+    return {};
+  }
+  text.remove_prefix(start);
+  std::size_t end = std::min(text.find_first_of(" \t"), text.size());
+  string_view field = text.substr(0, end);
+  text.remove_prefix(end);
+  return field;
+}
+
+long ParseLong(string_view from) {
+  long value = 0;
+  std::from_chars(from.data(), from.data() + from.size(), value);
+  return value;
+}
+
+void LinuxParser::ProcPath(string &path, int pid, const string &filename) {
+  char digits[16];
+  auto [end, error] = std::to_chars(digits, digits + sizeof(digits), pid);
+  path.assign(LinuxParser::kProcDirectory);
+  path.append(digits, end);
+  path.append(filename);
+}
+
+void ParseProcStatus(string_view contents,
+                     LinuxParser::ProcessValues &values) {
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    string_view key = NextField(line);
     if (key == "Uid:") {
-      values.user_id = value;
+      values.user_id = ParseLong(NextField(line));
     } else if (key == "VmSize:") {
-      values.vm_size = StoLSafe(value);
+      values.vm_size = ParseLong(NextField(line));
+    } else if (key == "VmRSS:") {
+      values.vm_rss = ParseLong(NextField(line));
+      break;  // VmRSS comes after the other keys we need
     }
-    return true;
-  };
-  ProcessFileLines(path, line_processor);
+  }
 }
 
-string ReadCommandFile(const string &path) {
-  string command;
-  auto line_processor = [&](string &line) -> bool {
-    command = line;
-    return false;  // exit after the first line
-  };
-  ProcessFileLines(path, line_processor);
-  return command;
+void ParseProcStat(string_view contents, LinuxParser::ProcessValues &values) {
+  // The command name in field 1 may itself contain spaces and brackets so
+  // start counting fields after the last closing bracket
+  std::size_t command_end = contents.rfind(')');
+  if (command_end == string_view::npos) {
+    return;
+  }
+  contents.remove_prefix(command_end + 1);
+  for (unsigned int field = 2; field <= kProcessor; ++field) {
+    string_view value = NextField(contents);
+    if (value.empty()) {
+      return;
+    }
+    if (field == kUtime) {
+      values.utime_ticks = ParseLong(value);
+    } else if (field == kStime) {
+      values.stime_ticks = ParseLong(value);
+    } else if (field == kStartTime) {
+      values.starttime_ticks = ParseLong(value);
+    } else if (field == kProcessor) {
+      values.processor = (int)ParseLong(value);
+    }
+  }
 }
 
-void ParseProcStatFile(const string &path, LinuxParser::ProcessValues &values) {
-  auto line_processor = [&](string &line) -> bool {
-    vector<string> parts = SplitLine(line);
-    if (parts.size() >= kStartTime) {
-      values.utime_ticks = StoLSafe(parts[kUtime]);
-      values.stime_ticks = StoLSafe(parts[kStime]);
-      values.starttime_ticks = StoLSafe(parts[kStartTime]);
+string_view CommandLine(string &contents) {
+  std::replace(contents.begin(), contents.end(), '\0', ' ');
+  string_view command(contents);
+  std::size_t end = command.find_last_not_of(' ');
+  return command.substr(0, end == string_view::npos ? 0 : end + 1);
+}
+
+void LinuxParser::RefreshUserNames(ProcessParseContext &context) {
+  struct stat info;
+  if (stat(LinuxParser::kPasswordPath.c_str(), &info) != 0) {
+    return;
+  }
+  long mtime_ns = info.st_mtim.tv_sec * 1000000000l + info.st_mtim.tv_nsec;
+  if (mtime_ns == context.passwd_mtime_ns) {
+    return;
+  }
+  context.passwd_mtime_ns = mtime_ns;
+  context.user_by_uid.clear();
+  ReadFile(LinuxParser::kPasswordPath, context.buffer);
+  string_view contents(context.buffer);
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    string_view parts[LinuxParser::kUserId + 1];
+    unsigned int part = 0;
+    for (; part <= LinuxParser::kUserId; ++part) {
+      std::size_t end = line.find(':');
+      parts[part] = line.substr(0, end);
+      if (end == string_view::npos) {
+        break;
+      }
+      line.remove_prefix(end + 1);
     }
-    return false;  // exit after the first line
-  };
-  ProcessFileLines(path, line_processor);
+    if (part >= LinuxParser::kUserId) {
+      context.user_by_uid[ParseLong(parts[LinuxParser::kUserId])] =
+          context.strings.Intern(parts[LinuxParser::kName]);
+    }
+  }
 }
 
-vector<LinuxParser::ProcessValues> LinuxParser::ProcessValuesList() {
-  vector<int> pids = Pids();
-  vector<ProcessValues> values_list{};
-  map<string, string> users = NameById();
+std::pmr::vector<LinuxParser::ProcessValues> LinuxParser::ProcessValuesList(
+    ProcessParseContext &context, std::pmr::memory_resource *scratch) {
+  std::pmr::vector<int> pids(scratch);
+  Pids(pids);
+  std::pmr::vector<ProcessValues> values_list(scratch);
+  values_list.reserve(pids.size());
+  RefreshUserNames(context);
 
   for (auto pid : pids) {
-    string path_base = kProcDirectory + std::to_string(pid) + "/";
     ProcessValues values{};
-    values.pid = pid;
+    if (ReadProcessValues(context, pid, values)) {
+      values_list.push_back(values);
+    }
+  }
+  return values_list;
+}
 
-    ParseProcStatusFile(path_base + kStatusFilename, values);
-    ParseProcStatFile(path_base + kStatFilename, values);
-    values.user = users[values.user_id];
+/**
+ * Look up the user of, and set the command of when command lines are not
+ * read, a process whose stat file has just been parsed
+ * @param context
+ * @param stat
+ * @param values
+ */
+static void FinishProcStat(LinuxParser::ProcessParseContext &context,
+                           string_view stat,
+                           LinuxParser::ProcessValues &values) {
+  if (context.probe) {
+    return;
+  }
+  auto user = context.user_by_uid.find(values.user_id);
+  if (user != context.user_by_uid.end()) {
+    values.user = user->second;
+  }
+  if (!context.read_command_lines) {
+    // The name in brackets in the stat file, as ps shows for kernel threads
+    std::size_t open = stat.find('(');
+    std::size_t close = stat.rfind(')');
+    if (open != string_view::npos && close != string_view::npos &&
+        open < close) {
+      values.command =
+          context.strings.Intern(stat.substr(open, close - open + 1));
+    }
+  }
+}
 
-    values.command = ReadCommandFile(path_base + kCmdlineFilename);
+bool LinuxParser::ReadProcessValues(ProcessParseContext &context, int pid,
+                                    ProcessValues &values) {
+  values.pid = pid;
 
-    values_list.push_back(values);
+  if (context.read_status) {
+    ProcPath(context.path, pid, kStatusFilename);
+    if (!ReadFile(context.path, context.buffer)) {
+      return false;  // the process exited since it was listed
+    }
+    ParseProcStatus(context.buffer, values);
   }
-  return values_list;
-}
\ No newline at end of file
+
+  ProcPath(context.path, pid, kStatFilename);
+  if (!ReadFile(context.path, context.buffer)) {
+    return false;
+  }
+  ParseProcStat(context.buffer, values);
+  FinishProcStat(context, context.buffer, values);
+
+  if (context.read_command_lines) {
+    ProcPath(context.path, pid, kCmdlineFilename);
+    ReadFile(context.path, context.buffer);
+    values.command = context.strings.Intern(CommandLine(context.buffer));
+  }
+  return true;
+}
+
+void LinuxParser::ParseProcessValues(ProcessParseContext &context, int pid,
+                                     ProcessFiles const &files,
+                                     ProcessValues &values) {
+  values.pid = pid;
+  if (context.read_status) {
+    ParseProcStatus(files.status, values);
+  }
+  ParseProcStat(files.stat, values);
+  FinishProcStat(context, files.stat, values);
+  if (context.read_command_lines) {
+    context.buffer.assign(files.cmdline);
+    values.command = context.strings.Intern(CommandLine(context.buffer));
+  }
+}
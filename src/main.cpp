@@ -1,7 +1,72 @@
+#include <iostream>
+#include <string>
+
+#include "fleet_agent.h"
+#include "fleet_aggregator.h"
+#include "history_query.h"
 #include "ncurses_display.h"
+#include "options.h"
+#include "overhead_governor.h"
+#include "refresh_scheduler.h"
+#include "shutdown.h"
 #include "system.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!Options::Parse(argc, argv, options)) {
+    return 1;
+  }
+  if (!options.query.empty()) {
+    std::string error;
+    if (!HistoryQuery::Run(options.query, options.query_from,
+                           options.query_to, options.query_tier,
+                           options.query_top, std::cout, error)) {
+      std::cerr << error << "\n";
+      return 1;
+    }
+    return 0;
+  }
+  // Returning from the display and agent loops of every mode below,
+  // rather than being killed, restores the terminal and lets the history
+  // store write out its incomplete buckets as System is destroyed
+  Shutdown::Install();
+  if (options.aggregate_port != 0) {
+    FleetAggregator aggregator;
+    std::string error;
+    if (!aggregator.Listen(options.aggregate_port, error)) {
+      std::cerr << error << "\n";
+      return 1;
+    }
+    NCursesDisplay::DisplayFleet(aggregator);
+    return 0;
+  }
   System system;
-  NCursesDisplay::Display(system);
-}
\ No newline at end of file
+  system.CpuFloor(options.cpu_floor);
+  if (options.io_uring && !system.Reader().UseIoUring()) {
+    std::cerr << "io_uring is not available, reading process files "
+                 "synchronously\n";
+  }
+  std::string error;
+  if (!options.alerts.empty() &&
+      !AlertEngine::Compile(options.alerts, system.Alerts(), error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+  if (!options.history.empty() &&
+      !system.Store().Open(options.history, error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+  RefreshScheduler refresh(
+      std::chrono::milliseconds(options.fast_interval_ms),
+      std::chrono::milliseconds(options.calm_interval_ms));
+  refresh.Arm();
+  OverheadGovernor governor(options.cpu_budget / 100.0f,
+                            options.memory_budget_mb * Process::MB_KB);
+  if (!options.agent_host.empty()) {
+    FleetAgent agent(options.agent_host, options.agent_port);
+    agent.Run(system, refresh, governor);
+    return 0;
+  }
+  NCursesDisplay::Display(system, refresh, governor);
+}
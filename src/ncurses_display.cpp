@@ -1,11 +1,16 @@
 #include <curses.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "format.h"
 #include "ncurses_display.h"
+#include "shutdown.h"
 #include "system.h"
 
 using std::string;
@@ -28,83 +33,690 @@ std::string NCursesDisplay::ProgressBar(float percent) {
   return result + " " + display + "/100%";
 }
 
-void NCursesDisplay::DisplaySystem(System& system, WINDOW* window) {
+/**
+ * Print text at a row and column of window, cut off at the window's right
+ * border rather than wrapped onto the next row. Unlike mvwprintw, text is not
+ * a format
+ * @param window
+ * @param row
+ * @param column
+ * @param text
+ */
+static void PrintClipped(WINDOW* window, int row, int column,
+                         string const& text) {
+  int width = getmaxx(window) - column - 1;
+  if (width > 0) {
+    mvwaddnstr(window, row, column, text.c_str(), width);
+  }
+}
+
+void NCursesDisplay::DisplaySystem(System& system,
+                                   RefreshScheduler const& scheduler,
+                                   OverheadGovernor const& governor,
+                                   WINDOW* window) {
   int row{0};
   mvwprintw(window, ++row, 2, ("OS: " + system.OperatingSystem()).c_str());
   mvwprintw(window, ++row, 2, ("Kernel: " + system.Kernel()).c_str());
   mvwprintw(window, ++row, 2, "CPU: ");
   wattron(window, COLOR_PAIR(1));
-  mvwprintw(window, row, 10, "");
-  wprintw(window, ProgressBar(system.Cpu().Utilization()).c_str());
+  PrintClipped(window, row, 10, ProgressBar(system.Load().cpu));
   wattroff(window, COLOR_PAIR(1));
   mvwprintw(window, ++row, 2, "Memory: ");
   wattron(window, COLOR_PAIR(1));
-  mvwprintw(window, row, 10, "");
-  wprintw(window, ProgressBar(system.MemoryUtilization()).c_str());
+  PrintClipped(window, row, 10, ProgressBar(system.Load().memory));
   wattroff(window, COLOR_PAIR(1));
   mvwprintw(window, ++row, 2,
-            ("Total Processes: " + to_string(system.TotalProcesses())).c_str());
+            ("Total Processes: " + to_string(system.Load().total)).c_str());
   mvwprintw(
       window, ++row, 2,
-      ("Running Processes: " + to_string(system.RunningProcesses())).c_str());
+      ("Running Processes: " + to_string(system.Load().running)).c_str());
   mvwprintw(window, ++row, 2,
             ("Up Time: " + Format::ElapsedTime(system.UpTime())).c_str());
+  SystemPressure pressure = system.Pressure();
+  if (pressure.available) {
+    mvwprintw(window, ++row, 2,
+              ("Pressure (some avg10): cpu " +
+               to_string(pressure.cpu.some.avg10).substr(0, 4) + "%%  memory " +
+               to_string(pressure.memory.some.avg10).substr(0, 4) +
+               "%%  io " + to_string(pressure.io.some.avg10).substr(0, 4) +
+               "%%")
+                  .c_str());
+  }
+  string wake = !scheduler.Armed() ? "fixed, no pressure triggers"
+                : scheduler.LastWake() == RefreshScheduler::Wake::kPressure
+                    ? "pressure trigger fired"
+                    : "calm";
+  mvwprintw(window, ++row, 2,
+            ("Refresh: every " + to_string(scheduler.Interval().count()) +
+             " ms (" + wake + ")")
+                .c_str());
+  SampleScheduler const& sampling = system.Sampling();
+  mvwprintw(window, ++row, 2,
+            ("Sampled: " + to_string(sampling.Read()) + "/" +
+             to_string(sampling.Seen()) + " processes this refresh, " +
+             to_string(sampling.Probes()) + " probed")
+                .c_str());
+  string budget = "no budget";
+  if (governor.Enforcing()) {
+    budget = "budget";
+    if (governor.CpuBudget() > 0) {
+      budget += " " + to_string(governor.CpuBudget() * 100).substr(0, 4) +
+                "%% of a core";
+    }
+    if (governor.MemoryBudgetKb() > 0) {
+      budget += " " + to_string(governor.MemoryBudgetKb() / Process::MB_KB) +
+                " MB";
+    }
+    budget += ": level " + to_string(governor.Level()) + ", " +
+              OverheadGovernor::Describe(governor.Level());
+  }
+  if (governor.Level() > 0) {
+    wattron(window, COLOR_PAIR(4));
+  }
+  mvwprintw(window, ++row, 2,
+            ("Monitor: " + to_string(governor.CpuUsage() * 100).substr(0, 4) +
+             "%% of a core, " +
+             to_string(governor.ResidentKb() / Process::MB_KB) + " MB (" +
+             budget + ")")
+                .c_str());
+  wattroff(window, COLOR_PAIR(4));
+  AlertEngine& alerts = system.Alerts();
+  if (!alerts.Empty()) {
+    if (alerts.Firing() > 0) {
+      wattron(window, COLOR_PAIR(3));
+    }
+    mvwprintw(window, ++row, 2,
+              ("Alerts: " + to_string(alerts.Firing()) + " firing of " +
+               to_string(alerts.Rules()) + " rules")
+                  .c_str());
+    wattroff(window, COLOR_PAIR(3));
+  }
   wrefresh(window);
 }
 
+void NCursesDisplay::DisplayDevices(DeviceRates const& devices,
+                                    DeviceRows& rows, WINDOW* window) {
+  int const height{std::max(getmaxy(window) - 3, 0)};
+  int const name_column{2};
+  int const rx_column{20};
+  int const tx_column{30};
+  int const disk_column{std::max(getmaxx(window) / 2, 42)};
+  int const reads_column{disk_column + 18};
+  int const writes_column{disk_column + 26};
+  int const read_bytes_column{disk_column + 34};
+  int const write_bytes_column{disk_column + 44};
+  int const utilization_column{disk_column + 54};
+  int row{0};
+  // Columns past the right border of a narrow terminal are cut off
+  wattron(window, COLOR_PAIR(2));
+  PrintClipped(window, ++row, name_column,
+               "NETWORK (" + to_string(devices.Interfaces()) + ")");
+  PrintClipped(window, row, rx_column, "RX/s");
+  PrintClipped(window, row, tx_column, "TX/s");
+  PrintClipped(window, row, disk_column,
+               "DISK (" + to_string(devices.Disks()) + ")");
+  PrintClipped(window, row, reads_column, "R/s");
+  PrintClipped(window, row, writes_column, "W/s");
+  PrintClipped(window, row, read_bytes_column, "READ/s");
+  PrintClipped(window, row, write_bytes_column, "WRITE/s");
+  PrintClipped(window, row, utilization_column, "UTIL");
+  wattroff(window, COLOR_PAIR(2));
+
+  // Only the busiest devices are shown, however many there are
+  devices.TopInterfaces(height, rows.interfaces);
+  devices.TopDisks(height, rows.disks);
+  row = 1;
+  for (auto const& interface : rows.interfaces) {
+    PrintClipped(window, ++row, name_column,
+                 string(interface.name.substr(0, rx_column - name_column - 1)));
+    PrintClipped(window, row, rx_column, Format::Bytes(interface.rx_bytes));
+    PrintClipped(window, row, tx_column, Format::Bytes(interface.tx_bytes));
+  }
+  row = 1;
+  for (auto const& disk : rows.disks) {
+    PrintClipped(window, ++row, disk_column,
+                 string(disk.name.substr(0, reads_column - disk_column - 1)));
+    PrintClipped(window, row, reads_column, to_string((long)disk.reads));
+    PrintClipped(window, row, writes_column, to_string((long)disk.writes));
+    PrintClipped(window, row, read_bytes_column,
+                 Format::Bytes(disk.read_bytes));
+    PrintClipped(window, row, write_bytes_column,
+                 Format::Bytes(disk.write_bytes));
+    PrintClipped(window, row, utilization_column,
+                 to_string(disk.utilization * 100).substr(0, 4) + "%");
+  }
+  wrefresh(window);
+}
+
+/**
+ * Characters used to draw the load on a cpu, from lowest to highest
+ */
+static const char kHeatLevels[] = ".:-=+*#%@";
+static const size_t kHeatLevelCount = sizeof(kHeatLevels) - 1;
+
+/**
+ * Column of the topology panel where the per cpu cells start
+ */
+static const int kTopologyCellColumn{34};
+
+/**
+ * The number of cells which fit on a row of the topology panel
+ * @param width
+ * @return
+ */
+static size_t TopologyCells(int width) {
+  return (size_t)std::max(width - kTopologyCellColumn - 2, 8);
+}
+
+/**
+ * The height of the topology panel: a row for each node, or more when a
+ * node has more cpus than fit on one row, and a row for the selection
+ * @param topology
+ * @param width
+ * @return
+ */
+static int TopologyHeight(CpuTopology const& topology, int width) {
+  size_t cells = TopologyCells(width);
+  size_t rows = 0;
+  for (auto const& node : topology.Nodes()) {
+    rows += std::max((node.cpus.size() + cells - 1) / cells, (size_t)1);
+  }
+  return (int)rows + 3;
+}
+
+void NCursesDisplay::DisplayTopology(CpuTopology const& topology,
+                                     Process const* selected,
+                                     LinuxParser::PlacementValues const& placement,
+                                     WINDOW* window) {
+  int const node_column{2};
+  int const utilization_column{10};
+  int const processes_column{17};
+  size_t const cells{TopologyCells(getmaxx(window))};
+  std::vector<CoreLoad> const& cores = topology.Cores();
+  mvwprintw(window, 0, 2, " CPU LOAD BY NUMA NODE ");
+  int row{0};
+  for (auto const& node : topology.Nodes()) {
+    mvwprintw(window, ++row, node_column, ("node" + to_string(node.id)).c_str());
+    mvwprintw(window, row, utilization_column,
+              (to_string((int)(node.utilization * 100)) + "%%").c_str());
+    mvwprintw(window, row, processes_column,
+              (to_string(node.processes) + " procs " +
+               to_string((int)(node.process_cpu * 100)) + "%%")
+                  .c_str());
+    for (size_t i = 0; i < node.cpus.size(); ++i) {
+      if (i > 0 && i % cells == 0) {
+        ++row;
+      }
+      int cpu = node.cpus[i];
+      float load = (size_t)cpu < cores.size() ? cores[cpu].utilization : 0.0f;
+      int color = load >= 0.8f ? 3 : load >= 0.5f ? 4 : 1;
+      wattron(window, COLOR_PAIR(color));
+      mvwaddch(window, row, kTopologyCellColumn + (int)(i % cells),
+               kHeatLevels[(size_t)(load * (kHeatLevelCount - 1))]);
+      wattroff(window, COLOR_PAIR(color));
+    }
+  }
+  if (selected == nullptr) {
+    return;
+  }
+  int cpu = selected->Values().processor;
+  string line = "PID " + to_string(selected->Pid()) + " last ran on cpu " +
+                to_string(cpu) + " (node " + to_string(topology.NodeOf(cpu)) +
+                ")  allowed " + placement.cpus_allowed + "  memory";
+  for (size_t node = 0; node < placement.node_kb.size(); ++node) {
+    if (placement.node_kb[node] > 0) {
+      line += " node" + to_string(node) + " " +
+              Format::Bytes((double)placement.node_kb[node] * 1024);
+    }
+  }
+  mvwprintw(window, ++row, node_column,
+            line.substr(0, std::max(getmaxx(window) - node_column - 1, 0))
+                .c_str());
+}
+
 void NCursesDisplay::DisplayProcesses(std::vector<Process>& processes,
-                                      WINDOW* window, int n) {
+                                      ProcessHistory const& history,
+                                      ProcessSort sort, ProcessListView& view,
+                                      WINDOW* window) {
   int row{0};
   int const pid_column{2};
   int const user_column{9};
   int const cpu_column{16};
   int const ram_column{26};
   int const time_column{35};
-  int const command_column{46};
+  int const cpu_history_column{45};
+  int const ram_history_column{63};
+  // The histories are left out when they would not leave room for at least
+  // 20 characters of each command
+  bool const histories{getmaxx(window) >= 107};
+  int const core_column{histories ? 81 : cpu_history_column};
+  int const command_column{core_column + 6};
+  int const rows{std::max(getmaxy(window) - 3, 0)};
+  size_t const count{processes.size()};
+
+  // Keep the selection on the same process when the list is reordered,
+  // then scroll just far enough to keep it on screen
+  if (view.selected_pid >= 0 && (view.selected >= count ||
+                                 processes[view.selected].Pid() !=
+                                     view.selected_pid)) {
+    for (size_t i = 0; i < count; ++i) {
+      if (processes[i].Pid() == view.selected_pid) {
+        view.selected = i;
+        break;
+      }
+    }
+  }
+  view.selected = count == 0 ? 0 : std::min(view.selected, count - 1);
+  view.selected_pid = count == 0 ? -1 : processes[view.selected].Pid();
+  if (view.selected < view.top) {
+    view.top = view.selected;
+  } else if (rows > 0 && view.selected >= view.top + rows) {
+    view.top = view.selected - rows + 1;
+  }
+  view.top = std::min(view.top, count > (size_t)rows ? count - rows : 0);
+
+  auto heading = [&](ProcessSort key, int column, char const* text) {
+    int attributes = key == sort ? A_BOLD | A_UNDERLINE : A_NORMAL;
+    wattron(window, attributes);
+    mvwprintw(window, row, column, text);
+    wattroff(window, attributes);
+  };
   wattron(window, COLOR_PAIR(2));
-  mvwprintw(window, ++row, pid_column, "PID");
+  ++row;
+  heading(ProcessSort::kPid, pid_column, "PID");
+  heading(ProcessSort::kUser, user_column, "USER");
+  heading(ProcessSort::kCpu, cpu_column, "CPU[%%]");
+  heading(ProcessSort::kRam, ram_column, "RAM[MB]");
+  heading(ProcessSort::kTime, time_column, "TIME+");
+  if (histories) {
+    mvwprintw(window, row, cpu_history_column, "CPU HISTORY");
+    mvwprintw(window, row, ram_history_column, "RSS HISTORY");
+  }
+  mvwprintw(window, row, core_column, "CORE");
+  mvwprintw(window, row, command_column, "COMMAND");
+  wattroff(window, COLOR_PAIR(2));
+
+  // Only the rows on screen are formatted, however long the list is. Users,
+  // commands and sparklines can all hold '%', so every column is printed
+  // as text rather than as a format
+  size_t const end{std::min(view.top + rows, count)};
+  for (size_t i = view.top; i < end; ++i) {
+    Process& process = processes[i];
+    PrintClipped(window, ++row, pid_column, to_string(process.Pid()));
+    PrintClipped(window, row, user_column,
+                 process.User().substr(0, cpu_column - user_column - 1));
+    float cpu = process.CpuUtilization() * 100;
+    PrintClipped(window, row, cpu_column, to_string(cpu).substr(0, 4));
+    PrintClipped(window, row, ram_column, process.Ram());
+    PrintClipped(window, row, time_column,
+                 Format::ElapsedTime(process.UpTime()));
+    if (histories) {
+      wattron(window, COLOR_PAIR(1));
+      PrintClipped(window, row, cpu_history_column,
+                   history.CpuSparkline(process.HistorySlot()));
+      PrintClipped(window, row, ram_history_column,
+                   history.RssSparkline(process.HistorySlot()));
+      wattroff(window, COLOR_PAIR(1));
+    }
+    PrintClipped(window, row, core_column,
+                 to_string(process.Values().processor));
+    PrintClipped(window, row, command_column, process.Command());
+    if (i == view.selected) {
+      mvwchgat(window, row, 1, getmaxx(window) - 2, A_REVERSE, 0, nullptr);
+    }
+  }
+
+  static char const* const sort_names[] = {"CPU", "RAM", "TIME", "PID",
+                                           "USER"};
+  string first = to_string(count == 0 ? 0 : view.top + 1);
+  string frame = to_string(view.frame_ms);
+  mvwprintw(window, getmaxy(window) - 1, 2,
+            (" Sort: " + string(sort_names[(int)sort]) +
+             " [c]pu [m]em [t]ime [p]id [u]ser  " + first + "-" +
+             to_string(end) + " of " + to_string(count) + "  key to frame " +
+             frame.substr(0, frame.find('.') + 3) + " ms ")
+                .c_str());
+}
+
+bool NCursesDisplay::HandleKey(int key, System& system, ProcessListView& view,
+                               int rows) {
+  size_t const page = (size_t)std::max(rows - 1, 1);
+  bool moved = true;
+  switch (key) {
+    case 'q':
+      return false;
+    case KEY_UP:
+    case 'k':
+      view.selected -= std::min(view.selected, (size_t)1);
+      break;
+    case KEY_DOWN:
+    case 'j':
+      ++view.selected;
+      break;
+    case KEY_PPAGE:
+      view.selected -= std::min(view.selected, page);
+      view.top -= std::min(view.top, page);
+      break;
+    case KEY_NPAGE:
+      view.selected += page;
+      view.top += page;
+      break;
+    case KEY_HOME:
+      view.selected = 0;
+      break;
+    case KEY_END:
+      // Clamped to the last process when drawn
+      view.selected = std::numeric_limits<int>::max();
+      break;
+    default:
+      moved = false;
+      break;
+  }
+  if (moved) {
+    // The selection moves to whichever process is at its new position
+    view.selected_pid = -1;
+    return true;
+  }
+  switch (key) {
+    case 'c':
+      system.Sort(ProcessSort::kCpu);
+      break;
+    case 'm':
+      system.Sort(ProcessSort::kRam);
+      break;
+    case 't':
+      system.Sort(ProcessSort::kTime);
+      break;
+    case 'p':
+      system.Sort(ProcessSort::kPid);
+      break;
+    case 'u':
+      system.Sort(ProcessSort::kUser);
+      break;
+  }
+  return true;
+}
+
+/**
+ * Create a window of the provided height below the windows above it, or
+ * return nullptr if there is not room for all of it above the rows kept
+ * for the windows below
+ * @param height
+ * @param width
+ * @param y the first free row, moved past the window
+ * @param rows_below
+ * @return
+ */
+static WINDOW* Panel(int height, int width, int& y, int rows_below) {
+  if (height <= 0 || y + height + rows_below > getmaxy(stdscr)) {
+    return nullptr;
+  }
+  WINDOW* window = newwin(height, width, y, 0);
+  if (window != nullptr) {
+    y += height;
+  }
+  return window;
+}
+
+/**
+ * (Re)create the windows to fit the terminal. The process list always
+ * gets at least kMinProcessHeight rows, and the other panels are left out,
+ * and their windows set to nullptr, from the bottom up when they do not fit
+ * @param system
+ * @param system_window
+ * @param device_window
+ * @param topology_window
+ * @param process_window
+ */
+static void Layout(System& system, WINDOW*& system_window,
+                   WINDOW*& device_window, WINDOW*& topology_window,
+                   WINDOW*& process_window) {
+  int const system_height{14};
+  int const device_height{7};
+  int const min_process_height{6};
+  for (WINDOW* window :
+       {system_window, device_window, topology_window, process_window}) {
+    if (window != nullptr) {
+      delwin(window);
+    }
+  }
+  // Clear whatever the old layout left outside the new windows
+  erase();
+  refresh();
+  int x_max{std::max(getmaxx(stdscr), 2)};
+  int y_max{getmaxy(stdscr)};
+  int topology_height{TopologyHeight(system.Topology(), x_max - 1)};
+  int y{0};
+  // The system panel shrinks rather than disappearing while it can still
+  // show a few rows
+  int system_rows{std::min(system_height, y_max - min_process_height)};
+  system_window = Panel(system_rows >= 4 ? system_rows : 0, x_max - 1, y,
+                        min_process_height);
+  device_window = Panel(device_height, x_max - 1, y, min_process_height);
+  topology_window = Panel(topology_height, x_max - 1, y, min_process_height);
+  process_window = newwin(std::max(y_max - y, 1), x_max - 1, y, 0);
+  // Input is only read once the scheduler has seen it arrive, so it must
+  // never block, even from stdscr on a terminal too small for any window
+  keypad(stdscr, TRUE);
+  nodelay(stdscr, TRUE);
+  if (process_window != nullptr) {
+    keypad(process_window, TRUE);
+    nodelay(process_window, TRUE);
+  }
+}
+
+void NCursesDisplay::Display(System& system, RefreshScheduler& scheduler,
+                             OverheadGovernor& governor) {
+  initscr();      // start ncurses
+  noecho();       // do not print input values
+  cbreak();       // terminate ncurses on ctrl + c
+  start_color();  // enable color
+  curs_set(0);
+  init_pair(1, COLOR_BLUE, COLOR_BLACK);
+  init_pair(2, COLOR_GREEN, COLOR_BLACK);
+  init_pair(3, COLOR_RED, COLOR_BLACK);
+  init_pair(4, COLOR_YELLOW, COLOR_BLACK);
+
+  WINDOW* system_window{nullptr};
+  WINDOW* device_window{nullptr};
+  WINDOW* topology_window{nullptr};
+  WINDOW* process_window{nullptr};
+  Layout(system, system_window, device_window, topology_window,
+         process_window);
+  ProcessListView view{};
+  DeviceRows device_rows{};
+  std::vector<Process>* processes{nullptr};
+  LinuxParser::PlacementValues placement{};
+  int placement_pid{-1};
+
+  // The process list and the selected process's placement are redrawn on
+  // every key press, everything else only when sampling. Panels which do
+  // not fit the terminal have no window and are skipped
+  auto display_selection = [&]() {
+    if (process_window != nullptr) {
+      werase(process_window);
+      box(process_window, 0, 0);
+      DisplayProcesses(*processes, system.History(), system.SortKey(), view,
+                       process_window);
+    }
+    Process const* selected{nullptr};
+    if (view.selected < processes->size()) {
+      selected = &(*processes)[view.selected];
+    }
+    if (topology_window != nullptr) {
+      if (selected != nullptr && selected->Pid() != placement_pid) {
+        LinuxParser::ProcessPlacement(selected->Pid(), placement);
+        placement_pid = selected->Pid();
+      }
+      werase(topology_window);
+      box(topology_window, 0, 0);
+      DisplayTopology(system.Topology(), selected, placement,
+                      topology_window);
+      wrefresh(topology_window);
+    }
+    if (process_window != nullptr) {
+      wrefresh(process_window);
+    }
+  };
+
+  bool resample{true};
+  bool quit{false};
+  while (!quit && !Shutdown::Requested()) {
+    if (resample) {
+      // Refresh the processes first so the system panel can report on
+      // the sampling pass
+      processes = &system.Processes();
+      governor.Update();
+      governor.Apply(system, scheduler);
+      if (system_window != nullptr) {
+        werase(system_window);
+        box(system_window, 0, 0);
+        DisplaySystem(system, scheduler, governor, system_window);
+      }
+      if (device_window != nullptr) {
+        werase(device_window);
+        box(device_window, 0, 0);
+        DisplayDevices(system.Devices(), device_rows, device_window);
+      }
+      system.Topology().Update(*processes);
+      placement_pid = -1;
+      resample = false;
+    }
+    display_selection();
+
+    // Sleeps until the next refresh is due, pressure builds up or a key is
+    // pressed. Keys only redraw the list, without sampling again
+    if (scheduler.Wait(STDIN_FILENO) != RefreshScheduler::Wake::kInput) {
+      resample = true;
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    WINDOW* input = process_window != nullptr ? process_window : stdscr;
+    for (int key = wgetch(input); key != ERR; key = wgetch(input)) {
+      if (key == KEY_RESIZE) {
+        Layout(system, system_window, device_window, topology_window,
+               process_window);
+        input = process_window != nullptr ? process_window : stdscr;
+        resample = true;
+      } else if (!HandleKey(key, system, view, getmaxy(input) - 3)) {
+        quit = true;
+      }
+    }
+    if (!resample && !quit) {
+      display_selection();
+      view.frame_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    }
+  }
+  for (WINDOW* window :
+       {system_window, device_window, topology_window, process_window}) {
+    if (window != nullptr) {
+      delwin(window);
+    }
+  }
+  endwin();
+}
+
+void NCursesDisplay::DisplayFleetSummary(FleetAggregator& aggregator,
+                                         double seconds, WINDOW* window) {
+  int row{0};
+  size_t hosts = aggregator.Hosts();
+  double snapshots = (double)aggregator.Snapshots();
+  mvwprintw(window, ++row, 2,
+            ("Hosts: " + to_string(hosts) +
+             "  Processes: " + to_string(aggregator.Processes()))
+                .c_str());
+  mvwprintw(window, ++row, 2,
+            ("Snapshots/s: " + to_string((long)(snapshots / seconds)))
+                .c_str());
+  long bytes_per_snapshot =
+      snapshots > 0 ? (long)((double)aggregator.Bytes() / snapshots) : 0;
+  mvwprintw(window, ++row, 2,
+            ("Bytes/host/tick: " + to_string(bytes_per_snapshot)).c_str());
+  aggregator.ResetCounters();
+  wrefresh(window);
+}
+
+void NCursesDisplay::DisplayFleetProcesses(FleetAggregator& aggregator,
+                                           WINDOW* window, int n) {
+  int row{0};
+  int const host_column{2};
+  int const pid_column{20};
+  int const user_column{27};
+  int const cpu_column{36};
+  int const ram_column{44};
+  int const command_column{53};
+  wattron(window, COLOR_PAIR(2));
+  mvwprintw(window, ++row, host_column, "HOST");
+  mvwprintw(window, row, pid_column, "PID");
   mvwprintw(window, row, user_column, "USER");
   mvwprintw(window, row, cpu_column, "CPU[%%]");
   mvwprintw(window, row, ram_column, "RAM[MB]");
-  mvwprintw(window, row, time_column, "TIME+");
   mvwprintw(window, row, command_column, "COMMAND");
   wattroff(window, COLOR_PAIR(2));
-  for (int i = 0; i < n; ++i) {
-    mvwprintw(window, ++row, pid_column, to_string(processes[i].Pid()).c_str());
-    mvwprintw(window, row, user_column, processes[i].User().c_str());
-    float cpu = processes[i].CpuUtilization() * 100;
-    mvwprintw(window, row, cpu_column, to_string(cpu).substr(0, 4).c_str());
-    mvwprintw(window, row, ram_column, processes[i].Ram().c_str());
-    mvwprintw(window, row, time_column,
-              Format::ElapsedTime(processes[i].UpTime()).c_str());
-    mvwprintw(window, row, command_column,
-              processes[i].Command().substr(0, window->_maxx - 46).c_str());
+  std::vector<FleetAggregator::Entry> top;
+  aggregator.Top(n, top);
+  StringPool const& strings = aggregator.Strings();
+  // Host names, users and commands come from remote agents, so they are
+  // only ever printed as text, never as a format
+  for (auto const& entry : top) {
+    FleetProcess const& process = *entry.process;
+    PrintClipped(window, ++row, host_column,
+                 entry.host->name.substr(0, pid_column - host_column - 1));
+    PrintClipped(window, row, pid_column, to_string(process.pid));
+    PrintClipped(window, row, user_column,
+                 string(strings.View(process.user))
+                     .substr(0, cpu_column - user_column - 1));
+    float cpu = (float)process.cpu / FleetProtocol::kUtilizationScale * 100;
+    PrintClipped(window, row, cpu_column, to_string(cpu).substr(0, 4));
+    PrintClipped(window, row, ram_column,
+                 to_string(process.vm_rss / Process::MB_KB));
+    PrintClipped(
+        window, row, command_column,
+        string(strings.View(process.command))
+            .substr(0, std::max(getmaxx(window) - command_column - 1, 0)));
   }
 }
 
-void NCursesDisplay::Display(System& system, int n) {
+void NCursesDisplay::DisplayFleet(FleetAggregator& aggregator, int n) {
   initscr();      // start ncurses
   noecho();       // do not print input values
   cbreak();       // terminate ncurses on ctrl + c
   start_color();  // enable color
 
   int x_max{getmaxx(stdscr)};
-  WINDOW* system_window = newwin(9, x_max - 1, 0, 0);
+  WINDOW* summary_window = newwin(5, x_max - 1, 0, 0);
   WINDOW* process_window =
-      newwin(3 + n, x_max - 1, system_window->_maxy + 1, 0);
+      newwin(3 + n, x_max - 1, summary_window->_maxy + 1, 0);
+  nodelay(process_window, TRUE);
 
-  while (1) {
+  auto last = std::chrono::steady_clock::now();
+  bool quit{false};
+  while (!quit && !Shutdown::Requested()) {
+    // Stops early when a key is pressed or a signal arrives
+    if (aggregator.Pump(1000, STDIN_FILENO)) {
+      for (int key = wgetch(process_window); key != ERR;
+           key = wgetch(process_window)) {
+        quit = quit || key == 'q';
+      }
+    }
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last).count();
+    last = now;
+    werase(summary_window);
     werase(process_window);
     init_pair(1, COLOR_BLUE, COLOR_BLACK);
     init_pair(2, COLOR_GREEN, COLOR_BLACK);
-    box(system_window, 0, 0);
+    box(summary_window, 0, 0);
     box(process_window, 0, 0);
-    DisplaySystem(system, system_window);
-    DisplayProcesses(system.Processes(), process_window, n);
-    wrefresh(system_window);
+    DisplayFleetSummary(aggregator, seconds, summary_window);
+    DisplayFleetProcesses(aggregator, process_window, n);
+    wrefresh(summary_window);
     wrefresh(process_window);
     refresh();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
   }
+  delwin(summary_window);
+  delwin(process_window);
   endwin();
-}
\ No newline at end of file
+}
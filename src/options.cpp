@@ -0,0 +1,128 @@
+#include "options.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::string;
+
+/**
+ * Print a usage message to stderr
+ * @param program
+ */
+void Usage(const char* program) {
+  std::cerr << "usage: " << program << " [options]\n"
+            << "  --cpu-floor <fraction>  processes using at least this much "
+               "of a core are\n"
+            << "                          read every refresh (default 0.005)\n"
+            << "  --fast-interval <ms>    refresh interval under pressure "
+               "(default 250)\n"
+            << "  --calm-interval <ms>    longest refresh interval when calm "
+               "(default 4000)\n"
+            << "  --budget <percent>      most of a core the monitor may use "
+               "before it\n"
+            << "                          samples less (default: no budget)\n"
+            << "  --memory-budget <MB>    most memory the monitor may use "
+               "before it\n"
+            << "                          samples less (default: no budget)\n"
+            << "  --io-uring              read process files in batches with "
+               "io_uring\n"
+            << "  --alerts <path>         evaluate the alert rules in path "
+               "every refresh\n"
+            << "  --history <dir>         record every refresh into the "
+               "history store in dir\n"
+            << "  --query <dir>           print the history in dir instead "
+               "of monitoring\n"
+            << "    --from <time>         start of the range (default -1h)\n"
+            << "    --to <time>           end of the range (default now)\n"
+            << "                          times are now, epoch seconds, "
+               "-<n>[smhd] or\n"
+            << "                          YYYY-MM-DD[THH:MM[:SS]]\n"
+            << "    --tier <1s|1m|1h>     resolution (default: picked for "
+               "the range)\n"
+            << "    --top <n>             processes per row (default 5)\n"
+            << "  --agent <host:port>     stream snapshots to a fleet "
+               "aggregator instead of\n"
+            << "                          displaying them\n"
+            << "  --aggregate <port>      display the busiest processes "
+               "across the agents\n"
+            << "                          connected on port\n";
+}
+
+bool Options::Parse(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    bool has_value = i + 1 < argc;
+    if (arg == "--cpu-floor" && has_value) {
+      char* end;
+      options.cpu_floor = std::strtof(argv[++i], &end);
+      if (*end != '\0' || options.cpu_floor < 0.0f) {
+        Usage(argv[0]);
+        return false;
+      }
+    } else if ((arg == "--fast-interval" || arg == "--calm-interval") &&
+               has_value) {
+      int interval = std::atoi(argv[++i]);
+      if (interval <= 0) {
+        Usage(argv[0]);
+        return false;
+      }
+      (arg == "--fast-interval" ? options.fast_interval_ms
+                                : options.calm_interval_ms) = interval;
+    } else if (arg == "--budget" && has_value) {
+      char* end;
+      options.cpu_budget = std::strtof(argv[++i], &end);
+      if (*end != '\0' || options.cpu_budget < 0.0f) {
+        Usage(argv[0]);
+        return false;
+      }
+    } else if (arg == "--memory-budget" && has_value) {
+      options.memory_budget_mb = std::atol(argv[++i]);
+      if (options.memory_budget_mb <= 0) {
+        Usage(argv[0]);
+        return false;
+      }
+    } else if (arg == "--io-uring") {
+      options.io_uring = true;
+    } else if (arg == "--alerts" && has_value) {
+      options.alerts = argv[++i];
+    } else if (arg == "--history" && has_value) {
+      options.history = argv[++i];
+    } else if (arg == "--query" && has_value) {
+      options.query = argv[++i];
+    } else if (arg == "--from" && has_value) {
+      options.query_from = argv[++i];
+    } else if (arg == "--to" && has_value) {
+      options.query_to = argv[++i];
+    } else if (arg == "--tier" && has_value) {
+      options.query_tier = argv[++i];
+    } else if (arg == "--top" && has_value) {
+      int top = std::atoi(argv[++i]);
+      if (top < 0) {
+        Usage(argv[0]);
+        return false;
+      }
+      options.query_top = top;
+    } else if (arg == "--agent" && has_value) {
+      string target(argv[++i]);
+      std::size_t colon = target.rfind(':');
+      options.agent_port =
+          colon == string::npos ? 0 : std::atoi(target.c_str() + colon + 1);
+      if (options.agent_port <= 0 || options.agent_port > 65535) {
+        Usage(argv[0]);
+        return false;
+      }
+      options.agent_host = target.substr(0, colon);
+    } else if (arg == "--aggregate" && has_value) {
+      options.aggregate_port = std::atoi(argv[++i]);
+      if (options.aggregate_port <= 0 || options.aggregate_port > 65535) {
+        Usage(argv[0]);
+        return false;
+      }
+    } else {
+      Usage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
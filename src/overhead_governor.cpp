@@ -0,0 +1,101 @@
+#include "overhead_governor.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+
+#include "linux_parser.h"
+
+/**
+ * Weight of the newest measurement in the smoothed cpu usage
+ */
+static const float kSmoothing = 0.5f;
+
+OverheadGovernor::OverheadGovernor(float cpu_budget, long memory_budget_kb)
+    : cpu_budget_(cpu_budget),
+      memory_budget_kb_(memory_budget_kb),
+      cpu_seconds_(CpuSeconds()),
+      updated_(std::chrono::steady_clock::now()) {}
+
+double OverheadGovernor::CpuSeconds() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto seconds = [](timeval const& time) {
+    return (double)time.tv_sec + (double)time.tv_usec / 1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+void OverheadGovernor::Update() {
+  auto now = std::chrono::steady_clock::now();
+  double cpu_seconds = CpuSeconds();
+  double wall_seconds = std::chrono::duration<double>(now - updated_).count();
+  float usage = (float)((cpu_seconds - cpu_seconds_) /
+                        std::max(wall_seconds, 0.001));
+  cpu_seconds_ = cpu_seconds;
+  updated_ = now;
+  resident_kb_ = LinuxParser::SelfResidentKb();
+
+  // The first measurement after a change of level still includes time
+  // spent at the old level, so it replaces rather than joins the average
+  cpu_usage_ = settled_ ? kSmoothing * usage + (1 - kSmoothing) * cpu_usage_
+                        : usage;
+  if (!settled_) {
+    settled_ = true;
+    return;
+  }
+  if (!Enforcing()) {
+    return;
+  }
+
+  bool over = (cpu_budget_ > 0 && cpu_usage_ > cpu_budget_) ||
+              (memory_budget_kb_ > 0 && resident_kb_ > memory_budget_kb_);
+  bool under = (cpu_budget_ <= 0 || cpu_usage_ < kStepDownShare * cpu_budget_) &&
+               (memory_budget_kb_ <= 0 ||
+                resident_kb_ < kStepDownShare * memory_budget_kb_);
+  over_ = over ? over_ + 1 : 0;
+  under_ = under ? under_ + 1 : 0;
+  if (over_ >= kOverToStepUp && level_ < kMaxLevel) {
+    ++level_;
+  } else if (under_ >= kUnderToStepDown && level_ > 0) {
+    --level_;
+  } else {
+    return;
+  }
+  over_ = 0;
+  under_ = 0;
+  settled_ = false;
+}
+
+void OverheadGovernor::Apply(System& system,
+                             RefreshScheduler& scheduler) const {
+  SamplingLimits limits{};
+  limits.command_lines = level_ < 2;
+  limits.status = level_ < 3;
+  limits.top_k = level_ >= 4 ? kTopK : 0;
+  system.Limit(limits);
+  int stretch = level_ == 0 ? 1 : level_ < 5 ? 2 : 1 << (level_ - 3);
+  scheduler.Stretch(stretch);
+}
+
+int OverheadGovernor::Level() const { return level_; }
+
+char const* OverheadGovernor::Describe(int level) {
+  static char const* const descriptions[kMaxLevel + 1] = {
+      "full sampling",     "refresh x2",        "no command lines",
+      "no status reads",   "top 64 only",       "refresh x4",
+      "refresh x8",        "refresh x16"};
+  return descriptions[std::clamp(level, 0, kMaxLevel)];
+}
+
+float OverheadGovernor::CpuUsage() const { return cpu_usage_; }
+
+long OverheadGovernor::ResidentKb() const { return resident_kb_; }
+
+float OverheadGovernor::CpuBudget() const { return cpu_budget_; }
+
+long OverheadGovernor::MemoryBudgetKb() const { return memory_budget_kb_; }
+
+bool OverheadGovernor::Enforcing() const {
+  return cpu_budget_ > 0 || memory_budget_kb_ > 0;
+}
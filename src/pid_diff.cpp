@@ -0,0 +1,31 @@
+#include "pid_diff.h"
+
+using std::size_t;
+
+PidDiff::PidDiff(std::pmr::memory_resource* resource)
+    : previous(resource), exited(resource) {}
+
+void DiffPids(std::vector<int> const& previous,
+              std::pmr::vector<int> const& current, PidDiff& diff) {
+  diff.previous.clear();
+  diff.exited.clear();
+  diff.previous.reserve(current.size());
+  diff.continuing = 0;
+  diff.born = 0;
+  size_t j = 0;
+  for (int pid : current) {
+    while (j < previous.size() && previous[j] < pid) {
+      diff.exited.push_back(j++);
+    }
+    if (j < previous.size() && previous[j] == pid) {
+      diff.previous.push_back(j++);
+      ++diff.continuing;
+    } else {
+      diff.previous.push_back(PidDiff::kBorn);
+      ++diff.born;
+    }
+  }
+  while (j < previous.size()) {
+    diff.exited.push_back(j++);
+  }
+}
@@ -21,50 +21,87 @@ int Process::Pid() const { return process_values_.pid; }
 
 float Process::CpuUtilization() const { return utilization_; }
 
-string Process::Command() { return process_values_.command; }
+string Process::Command() {
+  return string(strings_->View(process_values_.command));
+}
 
 string Process::Ram() {
-  if ((unsigned long)process_values_.vm_size < MB_KB) {
-    return to_string(process_values_.vm_size) + " KB";
+  if ((unsigned long)process_values_.vm_rss < MB_KB) {
+    return to_string(process_values_.vm_rss) + " KB";
   }
-  return to_string(process_values_.vm_size / MB_KB) + " MB";
+  return to_string(process_values_.vm_rss / MB_KB) + " MB";
 }
 
-string Process::User() { return process_values_.user; }
+ProcessValues const& Process::Values() const { return process_values_; }
+
+long Process::RssKb() const { return process_values_.vm_rss; }
+
+long Process::StartTimeTicks() const { return process_values_.starttime_ticks; }
+
+int Process::HistorySlot() const { return history_slot_; }
+
+void Process::HistorySlot(int slot) { history_slot_ = slot; }
+
+std::size_t Process::Rank() const { return rank_; }
+
+void Process::Rank(std::size_t rank) { rank_ = rank; }
+
+string Process::User() { return string(strings_->View(process_values_.user)); }
 
 long int Process::UpTime() const {
-  return uptime_ - (process_values_.starttime_ticks / sysconf(_SC_CLK_TCK));
+  return (long)uptime_ -
+         (process_values_.starttime_ticks / sysconf(_SC_CLK_TCK));
+}
+
+SampleState& Process::Sampling() { return sampling_; }
+
+void Process::Reintern(StringPool& strings) {
+  for (ProcessValues* values : {&process_values_, &prev_process_values_}) {
+    values->user = strings.Intern(strings_->View(values->user));
+    values->command = strings.Intern(strings_->View(values->command));
+  }
 }
 
 bool Process::operator<(Process const& a) const {
   return a.CpuUtilization() < this->CpuUtilization();
 }
 
-Process::Process(long uptime, ProcessValues process_values)
+Process::Process(double uptime, ProcessValues process_values,
+                 StringPool const& strings)
     : uptime_(uptime),
-      prev_uptime_{},
+      sample_uptime_(uptime),
+      prev_sample_uptime_((double)process_values.starttime_ticks /
+                          (double)sysconf(_SC_CLK_TCK)),
       process_values_(std::move(process_values)),
-      prev_process_values_{} {
+      prev_process_values_{},
+      strings_(&strings) {
   // This first call will calculate the utilization since
-  // System start since the time delta will be 1.0
+  // the process started
   UpdateUtilization();
 }
-void Process::Update(long uptime, ProcessValues process_values) {
-  prev_uptime_ = uptime_;
+
+void Process::Update(double uptime, ProcessValues process_values) {
   uptime_ = uptime;
+  prev_sample_uptime_ = sample_uptime_;
+  sample_uptime_ = uptime;
   prev_process_values_ = process_values_;
   process_values_ = std::move(process_values);
   // This will calculate the utilization since the last update
   UpdateUtilization();
 }
 
+void Process::Age(double uptime) { uptime_ = uptime; }
+
 void Process::UpdateUtilization() {
   float total_time =
       process_secs(process_values_.utime_ticks, process_values_.stime_ticks);
   float prev_time = process_secs(prev_process_values_.utime_ticks,
                                  prev_process_values_.stime_ticks);
 
-  float time_delta = std::max((float)uptime_ - (float)prev_uptime_, 1.0f);
+  // Processes are read at different intervals depending on how busy they
+  // are, so always divide by the actual time between the two samples
+  float time_delta =
+      std::max((float)(sample_uptime_ - prev_sample_uptime_), 0.1f);
 
   float process_delta = total_time - prev_time;
   utilization_ = process_delta / time_delta;
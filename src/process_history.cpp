@@ -0,0 +1,115 @@
+#include "process_history.h"
+
+#include <algorithm>
+
+using std::size_t;
+using std::string;
+
+/**
+ * Characters used to draw a sparkline, from lowest to highest
+ */
+static const char kSparkLevels[] = " .:-=+*#%@";
+static const size_t kSparkLevelCount = sizeof(kSparkLevels) - 1;
+
+ProcessHistory::ProcessHistory(size_t capacity)
+    : capacity_(capacity),
+      cpu_(new float[capacity * kSamples]),
+      rss_(new std::uint32_t[capacity * kSamples]),
+      head_(new std::uint8_t[capacity]),
+      count_(new std::uint8_t[capacity]),
+      free_slots_(capacity) {
+  // Hand out low slots first so that a lightly loaded system only
+  // touches the start of the arena
+  for (size_t i = 0; i < capacity; ++i) {
+    free_slots_[i] = (int)(capacity - 1 - i);
+  }
+}
+
+int ProcessHistory::Acquire() {
+  if (free_slots_.empty()) {
+    return kNoSlot;
+  }
+  int slot = free_slots_.back();
+  free_slots_.pop_back();
+  Clear(slot);
+  return slot;
+}
+
+void ProcessHistory::Release(int slot) {
+  if (slot == kNoSlot) {
+    return;
+  }
+  free_slots_.push_back(slot);
+}
+
+void ProcessHistory::Clear(int slot) {
+  if (slot == kNoSlot) {
+    return;
+  }
+  head_[slot] = 0;
+  count_[slot] = 0;
+}
+
+void ProcessHistory::Push(int slot, float cpu, long rss_kb) {
+  if (slot == kNoSlot) {
+    return;
+  }
+  size_t index = (size_t)slot * kSamples + head_[slot];
+  cpu_[index] = cpu;
+  rss_[index] = (std::uint32_t)std::max(rss_kb, 0l);
+  head_[slot] = (std::uint8_t)((head_[slot] + 1) % kSamples);
+  if (count_[slot] < kSamples) {
+    ++count_[slot];
+  }
+}
+
+size_t ProcessHistory::Oldest(int slot) const {
+  return (head_[slot] + kSamples - count_[slot]) % kSamples;
+}
+
+template <typename F>
+string ProcessHistory::Sparkline(int slot, F scale) const {
+  string result(kSamples, ' ');
+  if (slot == kNoSlot) {
+    return result;
+  }
+  size_t base = (size_t)slot * kSamples;
+  size_t oldest = Oldest(slot);
+  // Right align the samples so the newest is always in the last column
+  size_t offset = kSamples - count_[slot];
+  for (size_t i = 0; i < count_[slot]; ++i) {
+    float level = std::clamp(scale(base + (oldest + i) % kSamples), 0.0f, 1.0f);
+    result[offset + i] = kSparkLevels[(size_t)(level * (kSparkLevelCount - 1))];
+  }
+  return result;
+}
+
+string ProcessHistory::CpuSparkline(int slot) const {
+  return Sparkline(slot, [&](size_t index) { return cpu_[index]; });
+}
+
+string ProcessHistory::RssSparkline(int slot) const {
+  if (slot == kNoSlot) {
+    return Sparkline(slot, [](size_t) { return 0.0f; });
+  }
+  size_t base = (size_t)slot * kSamples;
+  size_t oldest = Oldest(slot);
+  std::uint32_t peak = 0;
+  for (size_t i = 0; i < count_[slot]; ++i) {
+    peak = std::max(peak, rss_[base + (oldest + i) % kSamples]);
+  }
+  return Sparkline(slot, [&](size_t index) {
+    return (float)rss_[index] / std::max((float)peak, 1.0f);
+  });
+}
+
+size_t ProcessHistory::Capacity() const { return capacity_; }
+
+size_t ProcessHistory::FootprintBytes() const {
+  return FootprintBytes(Capacity());
+}
+
+size_t ProcessHistory::FootprintBytes(size_t capacity) {
+  return capacity * (kSamples * (sizeof(float) + sizeof(std::uint32_t)) +
+                     2 * sizeof(std::uint8_t) + sizeof(int));
+}
@@ -0,0 +1,340 @@
+#include "process_reader.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+using LinuxParser::ProcessFiles;
+using LinuxParser::ProcessParseContext;
+using LinuxParser::ProcessValues;
+using std::size_t;
+using std::string_view;
+
+/**
+ * The operations queued for each file. The user data of a completion is
+ * the file's slot * kOperations + its operation
+ */
+enum Operation : unsigned int { kOpen = 0, kRead, kClose, kOperations };
+
+/**
+ * Times in a row waiting for in flight operations may fail before their
+ * buffers are given up on
+ */
+static const int kDrainAttempts = 8;
+
+/**
+ * An io_uring with kBatchFiles registered buffers and fixed file slots
+ */
+struct ProcessReader::Ring {
+ public:
+  ~Ring() {
+    // Run waits for every operation it submits, or gives the buffers up if
+    // it can not, so nothing can still be writing into them once it is
+    // destroyed
+    if (sqes_map != MAP_FAILED) {
+      munmap(sqes_map, sqes_size);
+    }
+    if (rings != MAP_FAILED) {
+      munmap(rings, rings_size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  /**
+   * Set up the ring. Returns false if any part of it is not supported
+   * @return
+   */
+  bool Setup() {
+    io_uring_params params{};
+    // Keep submitting the rest of a batch if one operation is invalid
+    params.flags = IORING_SETUP_SUBMIT_ALL;
+    fd = (int)syscall(__NR_io_uring_setup, kBatchFiles * kOperations,
+                      &params);
+    if (fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      return false;
+    }
+    rings_size = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || sqes_map == MAP_FAILED) {
+      return false;
+    }
+    sqes = (io_uring_sqe*)sqes_map;
+    char* base = (char*)rings;
+    sq_tail = (unsigned int*)(base + params.sq_off.tail);
+    sq_mask = *(unsigned int*)(base + params.sq_off.ring_mask);
+    cq_head = (unsigned int*)(base + params.cq_off.head);
+    cq_tail = (unsigned int*)(base + params.cq_off.tail);
+    cq_mask = *(unsigned int*)(base + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(base + params.cq_off.cqes);
+    // Submission entries are always used in order
+    unsigned int* array = (unsigned int*)(base + params.sq_off.array);
+    for (unsigned int i = 0; i < params.sq_entries; ++i) {
+      array[i] = i;
+    }
+
+    // Files are opened into the ring's own table rather than as file
+    // descriptors, so that the read and close can be linked to the open
+    io_uring_rsrc_register files{};
+    files.nr = kBatchFiles;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES2, &files,
+                sizeof(files)) < 0) {
+      return false;
+    }
+    buffers.reset(new char[kBatchFiles * kFileBufferSize]);
+    iovec iovecs[kBatchFiles];
+    for (unsigned int slot = 0; slot < kBatchFiles; ++slot) {
+      iovecs[slot].iov_base = Buffer(slot);
+      iovecs[slot].iov_len = kFileBufferSize;
+    }
+    return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                   iovecs, kBatchFiles) == 0;
+  }
+
+  char* Buffer(unsigned int slot) {
+    return buffers.get() + slot * kFileBufferSize;
+  }
+
+  /**
+   * Queue an open, read and close of the file at paths[slot] into the
+   * buffer and fixed file of slot
+   * @param slot
+   */
+  void Queue(unsigned int slot) {
+    unsigned int tail = *sq_tail;
+    io_uring_sqe* open = &sqes[tail++ & sq_mask];
+    std::memset(open, 0, sizeof(*open));
+    open->opcode = IORING_OP_OPENAT;
+    open->fd = AT_FDCWD;
+    open->addr = (std::uint64_t)paths[slot].c_str();
+    open->open_flags = O_RDONLY;
+    open->file_index = slot + 1;
+    // The read and close are cancelled if the process has exited
+    open->flags = IOSQE_IO_LINK;
+    open->user_data = slot * kOperations + kOpen;
+
+    io_uring_sqe* read = &sqes[tail++ & sq_mask];
+    std::memset(read, 0, sizeof(*read));
+    read->opcode = IORING_OP_READ_FIXED;
+    read->fd = (int)slot;
+    read->addr = (std::uint64_t)Buffer(slot);
+    read->len = kFileBufferSize;
+    read->buf_index = (std::uint16_t)slot;
+    // A short read breaks an ordinary link, but the file must still close
+    read->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    read->user_data = slot * kOperations + kRead;
+
+    io_uring_sqe* close = &sqes[tail++ & sq_mask];
+    std::memset(close, 0, sizeof(*close));
+    close->opcode = IORING_OP_CLOSE;
+    close->file_index = slot + 1;
+    close->user_data = slot * kOperations + kClose;
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+  }
+
+  /**
+   * Submit every queued operation and wait for all of them to complete,
+   * keeping the result of each read in results. Returns false if the ring
+   * failed
+   * @param files
+   * @return
+   */
+  bool Run(unsigned int files) {
+    unsigned int const operations = files * kOperations;
+    unsigned int to_submit = operations;
+    unsigned int completed = 0;
+    while (completed < operations) {
+      int entered = (int)syscall(__NR_io_uring_enter, fd, to_submit,
+                                 operations - completed,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (entered < 0 && errno != EINTR) {
+        // Operations already submitted may still be writing into the
+        // buffers, so they are waited for before the ring is torn down
+        Drain(operations - to_submit - completed);
+        return false;
+      }
+      to_submit -= entered > 0 ? (unsigned int)entered : 0;
+      completed += Reap();
+    }
+    return true;
+  }
+
+  /**
+   * Consume every completion posted so far, keeping the result of each
+   * read in results
+   * @return the number of completions consumed
+   */
+  unsigned int Reap() {
+    unsigned int head = *cq_head;
+    unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned int reaped = tail - head;
+    for (; head != tail; ++head) {
+      io_uring_cqe const& cqe = cqes[head & cq_mask];
+      if (cqe.user_data % kOperations == kRead) {
+        results[cqe.user_data / kOperations] = cqe.res;
+      }
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+  }
+
+  /**
+   * Wait for the operations in flight when the ring failed to complete.
+   * If they can not be waited for the buffers are abandoned, rather than
+   * freed while the kernel may still write into them
+   * @param in_flight
+   */
+  void Drain(unsigned int in_flight) {
+    int failures = 0;
+    while (true) {
+      unsigned int reaped = Reap();
+      in_flight -= std::min(reaped, in_flight);
+      if (in_flight == 0) {
+        return;
+      }
+      int entered = (int)syscall(__NR_io_uring_enter, fd, 0, in_flight,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (entered < 0 && errno != EINTR && ++failures == kDrainAttempts) {
+        buffers.release();
+        return;
+      }
+    }
+  }
+
+  int fd{-1};
+  void* rings{MAP_FAILED};
+  size_t rings_size{};
+  void* sqes_map{MAP_FAILED};
+  io_uring_sqe* sqes{};
+  size_t sqes_size{};
+  unsigned int* sq_tail{};
+  unsigned int sq_mask{};
+  unsigned int* cq_head{};
+  unsigned int* cq_tail{};
+  unsigned int cq_mask{};
+  io_uring_cqe* cqes{};
+  std::unique_ptr<char[]> buffers{};
+  std::string paths[kBatchFiles]{};
+  int results[kBatchFiles]{};
+};
+
+ProcessReader::ProcessReader() = default;
+
+ProcessReader::~ProcessReader() = default;
+
+bool ProcessReader::UseIoUring() {
+  if (ring_) {
+    return true;
+  }
+  auto ring = std::make_unique<Ring>();
+  if (!ring->Setup()) {
+    return false;
+  }
+  ring_ = std::move(ring);
+  return true;
+}
+
+void ProcessReader::UseSync() { ring_.reset(); }
+
+ReaderBackend ProcessReader::Backend() const {
+  return ring_ ? ReaderBackend::kIoUring : ReaderBackend::kSync;
+}
+
+void ProcessReader::Read(ProcessParseContext& context,
+                         std::pmr::vector<int> const& pids,
+                         std::pmr::vector<ProcessValues>& values,
+                         std::pmr::vector<char>& read) {
+  values.assign(pids.size(), ProcessValues{});
+  read.assign(pids.size(), 0);
+  size_t first = 0;
+  if (ring_) {
+    size_t files = 1 + context.read_status + context.read_command_lines;
+    size_t batch = kBatchFiles / files;
+    for (; first < pids.size(); first += batch) {
+      size_t last = std::min(first + batch, pids.size());
+      if (!ReadBatch(context, pids, first, last, values, read)) {
+        UseSync();
+        break;
+      }
+    }
+  }
+  for (size_t i = first; i < pids.size(); ++i) {
+    read[i] = LinuxParser::ReadProcessValues(context, pids[i], values[i]);
+  }
+}
+
+bool ProcessReader::ReadBatch(ProcessParseContext& context,
+                              std::pmr::vector<int> const& pids,
+                              size_t first, size_t last,
+                              std::pmr::vector<ProcessValues>& values,
+                              std::pmr::vector<char>& read) {
+  Ring& ring = *ring_;
+  // Slots of each process's status, stat and cmdline, or kBatchFiles if
+  // not read
+  unsigned int const none = kBatchFiles;
+  unsigned int slot = 0;
+  auto queue = [&](int pid, std::string const& filename) {
+    LinuxParser::ProcPath(ring.paths[slot], pid, filename);
+    ring.Queue(slot++);
+  };
+  for (size_t i = first; i < last; ++i) {
+    if (context.read_status) {
+      queue(pids[i], LinuxParser::kStatusFilename);
+    }
+    queue(pids[i], LinuxParser::kStatFilename);
+    if (context.read_command_lines) {
+      queue(pids[i], LinuxParser::kCmdlineFilename);
+    }
+  }
+  if (!ring.Run(slot)) {
+    return false;
+  }
+
+  slot = 0;
+  for (size_t i = first; i < last; ++i) {
+    unsigned int status = context.read_status ? slot++ : none;
+    unsigned int stat = slot++;
+    unsigned int cmdline = context.read_command_lines ? slot++ : none;
+    auto result = [&](unsigned int file) {
+      return file == none ? 0 : ring.results[file];
+    };
+    auto contents = [&](unsigned int file) {
+      int size = result(file);
+      return size > 0 ? string_view(ring.Buffer(file), size) : string_view();
+    };
+    if (result(status) < 0 || result(stat) < 0) {
+      continue;  // the process exited since it was listed
+    }
+    if ((size_t)result(status) == kFileBufferSize ||
+        (size_t)result(stat) == kFileBufferSize ||
+        (size_t)result(cmdline) == kFileBufferSize) {
+      // Too large for its buffer, usually a long command line
+      read[i] = LinuxParser::ReadProcessValues(context, pids[i], values[i]);
+      continue;
+    }
+    ProcessFiles files;
+    files.status = contents(status);
+    files.stat = contents(stat);
+    files.cmdline = contents(cmdline);
+    LinuxParser::ParseProcessValues(context, pids[i], files, values[i]);
+    read[i] = 1;
+  }
+  return true;
+}
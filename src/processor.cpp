@@ -4,6 +4,10 @@
 float Processor::Utilization() {
   CPUValues values;
   CpuUtilization(values);
+  return Utilization(values);
+}
+
+float Processor::Utilization(CPUValues const& values) {
   long idle = CPUIdle(values);
   long prev_idle = CPUIdle(prev_values_);
 
@@ -20,11 +24,11 @@ float Processor::Utilization() {
   return (float)(total_delta - idle_delta) / std::max((float)total_delta, 1.0f);
 }
 
-long Processor::CPUIdle(CPUValues &values) {
+long Processor::CPUIdle(CPUValues const &values) {
   return values.idle + values.io_wait;
 }
 
-long Processor::CPUBusy(CPUValues &values) {
+long Processor::CPUBusy(CPUValues const &values) {
   return values.user + values.nice + values.system + values.irq +
          values.soft_irq + values.steal;
 }
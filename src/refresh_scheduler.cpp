@@ -0,0 +1,137 @@
+#include "refresh_scheduler.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+
+#include "linux_parser.h"
+
+using std::chrono::milliseconds;
+using std::string;
+
+RefreshScheduler::RefreshScheduler(milliseconds fast, milliseconds calm)
+    : fast_(fast), calm_(std::max(calm, fast)) {}
+
+RefreshScheduler::~RefreshScheduler() {
+  for (int fd : triggers_) {
+    close(fd);
+  }
+}
+
+bool RefreshScheduler::Arm() {
+  ArmTrigger(LinuxParser::kCpuPressureFilename);
+  ArmTrigger(LinuxParser::kMemoryPressureFilename);
+  ArmTrigger(LinuxParser::kIoPressureFilename);
+  if (Armed()) {
+    interval_ = fast_;
+  }
+  return Armed();
+}
+
+void RefreshScheduler::ArmTrigger(string const& filename) {
+  string path = LinuxParser::kPressureDirectory + filename;
+  int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  // Unprivileged triggers need a window which is a multiple of 2s, so fall
+  // back to that if the shorter window is refused
+  for (long window : {kWindowUs, 2 * kWindowUs}) {
+    string trigger = "some " + std::to_string(kStallThresholdUs * window /
+                                              kWindowUs) +
+                     " " + std::to_string(window);
+    if (write(fd, trigger.c_str(), trigger.size() + 1) > 0) {
+      triggers_.push_back(fd);
+      return;
+    }
+  }
+  close(fd);
+}
+
+RefreshScheduler::Wake RefreshScheduler::Wait(int input_fd) {
+  auto now = std::chrono::steady_clock::now();
+  if (!waiting_) {
+    deadline_ = now + Interval();
+    waiting_ = true;
+  }
+
+  while (true) {
+    pollfd fds[4];
+    std::size_t count = 0;
+    for (int fd : triggers_) {
+      fds[count++] = pollfd{fd, POLLPRI, 0};
+    }
+    if (input_fd >= 0) {
+      fds[count++] = pollfd{input_fd, POLLIN, 0};
+    }
+    auto remaining = std::chrono::ceil<milliseconds>(
+        deadline_ - std::chrono::steady_clock::now());
+    int ready = poll(fds, count, (int)std::max(remaining.count(), 0l));
+    if (ready < 0 && errno == EINTR) {
+      // A signal, for example a terminal resize, is treated as input
+      return Wake::kInput;
+    }
+    bool input = ready > 0 && input_fd >= 0 &&
+                 (fds[count - 1].revents & POLLIN);
+    bool failed = false;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < triggers_.size(); ++i) {
+      if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        // The trigger will never fire again, for example because its
+        // cgroup has been removed
+        close(triggers_[i]);
+        failed = true;
+        continue;
+      }
+      pressure_ = pressure_ || (fds[i].revents & POLLPRI);
+      triggers_[kept++] = triggers_[i];
+    }
+    triggers_.resize(kept);
+    if (failed && !Armed()) {
+      interval_ = calm_;
+    }
+    if (pressure_) {
+      // Pressure events are consumed by the poll which reports them, so
+      // one is remembered until the refresh it brings forward. A trigger
+      // firing every window would otherwise undo a stretch
+      deadline_ = std::min(deadline_, refreshed_ + fast_ * stretch_);
+    }
+    // Pressure is handled before input, which stays readable until it is
+    // read. A failed trigger alone is no reason to refresh early
+    if (ready == 0 || std::chrono::steady_clock::now() >= deadline_) {
+      break;
+    }
+    if (input) {
+      return Wake::kInput;
+    }
+  }
+
+  waiting_ = false;
+  refreshed_ = std::chrono::steady_clock::now();
+  if (pressure_) {
+    pressure_ = false;
+    interval_ = fast_;
+    last_wake_ = Wake::kPressure;
+  } else {
+    // Decay back towards the calm interval while nothing fires
+    if (Armed()) {
+      interval_ = std::min(interval_ * 2, calm_);
+    }
+    last_wake_ = Wake::kTimeout;
+  }
+  return last_wake_;
+}
+
+void RefreshScheduler::Stretch(int factor) { stretch_ = std::max(factor, 1); }
+
+milliseconds RefreshScheduler::Interval() const { return interval_ * stretch_; }
+
+bool RefreshScheduler::Armed() const { return !triggers_.empty(); }
+
+RefreshScheduler::Wake RefreshScheduler::LastWake() const {
+  return last_wake_;
+}
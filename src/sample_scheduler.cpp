@@ -0,0 +1,82 @@
+#include "sample_scheduler.h"
+
+using std::size_t;
+
+const unsigned long SampleScheduler::kTierIntervals[kTiers] = {1, 5, 10, 30};
+
+SampleScheduler::SampleScheduler(float cpu_floor) : cpu_floor_(cpu_floor) {}
+
+void SampleScheduler::BeginTick() {
+  ++tick_;
+  read_ = 0;
+  probes_ = 0;
+  seen_ = 0;
+}
+
+bool SampleScheduler::Due(SampleState const& state, int pid,
+                          float utilization) const {
+  if (cutoff_ >= 0.0f && utilization < cutoff_) {
+    return (tick_ + (unsigned long)pid) % kTierIntervals[kTiers - 1] == 0;
+  }
+  return state.next_tick <= tick_;
+}
+
+bool SampleScheduler::Probing() const { return cutoff_ < 0.0f; }
+
+void SampleScheduler::Sampled(SampleState& state, int pid,
+                              float utilization) {
+  ++read_;
+  ++seen_;
+  if (utilization >= cpu_floor_) {
+    // Promote on change
+    state.tier = 0;
+    state.quiet_samples = 0;
+  } else if (++state.quiet_samples >= kQuietSamplesToDemote &&
+             state.tier + 1u < kTiers) {
+    ++state.tier;
+    state.quiet_samples = 0;
+    ScheduleDemoted(state, pid);
+    return;
+  }
+  Schedule(state);
+}
+
+void SampleScheduler::Probed(SampleState& state, float utilization) {
+  ++probes_;
+  ++seen_;
+  if (utilization >= cpu_floor_) {
+    state.tier = 0;
+    state.quiet_samples = 0;
+    state.next_tick = tick_ + 1;
+  }
+}
+
+void SampleScheduler::Born(SampleState& state) {
+  ++read_;
+  ++seen_;
+  state = SampleState{};
+  Schedule(state);
+}
+
+void SampleScheduler::Skipped() { ++seen_; }
+
+float SampleScheduler::CpuFloor() const { return cpu_floor_; }
+
+void SampleScheduler::CpuFloor(float cpu_floor) { cpu_floor_ = cpu_floor; }
+
+void SampleScheduler::Cutoff(float cutoff) { cutoff_ = cutoff; }
+
+size_t SampleScheduler::Read() const { return read_; }
+
+size_t SampleScheduler::Probes() const { return probes_; }
+
+size_t SampleScheduler::Seen() const { return seen_; }
+
+void SampleScheduler::Schedule(SampleState& state) const {
+  state.next_tick = tick_ + kTierIntervals[state.tier];
+}
+
+void SampleScheduler::ScheduleDemoted(SampleState& state, int pid) const {
+  unsigned long interval = kTierIntervals[state.tier];
+  state.next_tick = tick_ + 1 + (unsigned long)pid % interval;
+}
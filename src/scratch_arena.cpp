@@ -0,0 +1,45 @@
+#include "scratch_arena.h"
+
+#include <new>
+
+using std::size_t;
+
+ScratchArena::ScratchArena(size_t initial_bytes)
+    : capacity_(initial_bytes),
+      buffer_(new std::byte[initial_bytes]),
+      arena_(new std::pmr::monotonic_buffer_resource(buffer_.get(), capacity_,
+                                                     &overflow_)) {}
+
+std::pmr::memory_resource* ScratchArena::Resource() { return arena_.get(); }
+
+void ScratchArena::Reset() {
+  arena_->release();
+  if (overflow_.bytes > 0) {
+    // The last refresh did not fit, so grow the buffer to hold everything
+    // it needed with some room to spare
+    capacity_ = (capacity_ + overflow_.bytes) * 2;
+    overflow_.bytes = 0;
+    arena_.reset();
+    buffer_.reset(new std::byte[capacity_]);
+    arena_.reset(new std::pmr::monotonic_buffer_resource(
+        buffer_.get(), capacity_, &overflow_));
+  }
+}
+
+size_t ScratchArena::Capacity() const { return capacity_; }
+
+void* ScratchArena::OverflowResource::do_allocate(size_t bytes,
+                                                  size_t alignment) {
+  this->bytes += bytes;
+  return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+void ScratchArena::OverflowResource::do_deallocate(void* p, size_t bytes,
+                                                   size_t alignment) {
+  ::operator delete(p, bytes, std::align_val_t(alignment));
+}
+
+bool ScratchArena::OverflowResource::do_is_equal(
+    std::pmr::memory_resource const& other) const noexcept {
+  return this == &other;
+}
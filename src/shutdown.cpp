@@ -0,0 +1,25 @@
+#include "shutdown.h"
+
+#include <signal.h>
+
+#include <initializer_list>
+
+/**
+ * Set by the signal handler, which may only touch a sig_atomic_t
+ */
+static volatile sig_atomic_t requested = 0;
+
+static void Request(int) { requested = 1; }
+
+void Shutdown::Install() {
+  struct sigaction action {};
+  action.sa_handler = Request;
+  sigemptyset(&action.sa_mask);
+  // No SA_RESTART, so that a wait for the next refresh ends with EINTR
+  action.sa_flags = 0;
+  for (int signal : {SIGINT, SIGTERM, SIGHUP}) {
+    sigaction(signal, &action, nullptr);
+  }
+}
+
+bool Shutdown::Requested() { return requested != 0; }
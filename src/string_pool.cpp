@@ -0,0 +1,65 @@
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::size_t;
+using std::string_view;
+
+/**
+ * Generation of the most recently constructed pool
+ */
+static std::uint64_t last_generation = 0;
+
+StringPool::StringPool() : generation_(++last_generation) {
+  strings_.emplace_back();
+  ids_.emplace(string_view{}, kEmpty);
+}
+
+StringPool::Id StringPool::Intern(string_view value) {
+  auto found = ids_.find(value);
+  if (found != ids_.end()) {
+    return found->second;
+  }
+  string_view stored = Store(value);
+  Id id = (Id)strings_.size();
+  strings_.push_back(stored);
+  ids_.emplace(stored, id);
+  return id;
+}
+
+string_view StringPool::View(Id id) const {
+  if (id >= strings_.size()) {
+    return strings_[kEmpty];
+  }
+  return strings_[id];
+}
+
+size_t StringPool::Size() const { return strings_.size(); }
+
+size_t StringPool::StorageBytes() const { return storage_bytes_; }
+
+std::uint64_t StringPool::Generation() const { return generation_; }
+
+string_view StringPool::Store(string_view value) {
+  if (value.size() > kBlockSize) {
+    // Oversized strings get a block of their own, kept behind the current
+    // block so that the space left in it is not wasted
+    std::unique_ptr<char[]> block(new char[value.size()]);
+    std::memcpy(block.get(), value.data(), value.size());
+    string_view stored{block.get(), value.size()};
+    blocks_.insert(blocks_.empty() ? blocks_.end() : blocks_.end() - 1,
+                   std::move(block));
+    storage_bytes_ += value.size();
+    return stored;
+  }
+  if (value.size() > kBlockSize - block_used_) {
+    blocks_.emplace_back(new char[kBlockSize]);
+    block_used_ = 0;
+    storage_bytes_ += kBlockSize;
+  }
+  char* start = blocks_.back().get() + block_used_;
+  std::memcpy(start, value.data(), value.size());
+  block_used_ += value.size();
+  return string_view{start, value.size()};
+}
@@ -1,9 +1,13 @@
 #include "system.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
+#include "adaptive_sort.h"
 #include "linux_parser.h"
+#include "pid_diff.h"
 #include "process.h"
 #include "processor.h"
 
@@ -15,44 +19,380 @@ using std::vector;
 
 Processor& System::Cpu() { return cpu_; }
 
+SystemLoad const& System::Load() const { return load_; }
+
+DeviceRates& System::Devices() { return devices_; }
+
+CpuTopology& System::Topology() { return topology_; }
+
+ProcessReader& System::Reader() { return reader_; }
+
+ProcessHistory const& System::History() const { return history_; }
+
+SampleScheduler const& System::Sampling() const { return scheduler_; }
+
+void System::CpuFloor(float cpu_floor) { scheduler_.CpuFloor(cpu_floor); }
+
+AlertEngine& System::Alerts() { return alerts_; }
+
+HistoryStore& System::Store() { return store_; }
+
+StringPool const& System::Strings() const { return parse_context_.strings; }
+
+/**
+ * Where a process goes when ordered by key: ascending values come first
+ * @param key
+ * @param process
+ * @param user_order position of each user id's name in name order, only
+ * filled when ordering by user
+ * @return
+ */
+static double SortValue(ProcessSort key, Process const& process,
+                        vector<std::uint32_t> const& user_order) {
+  switch (key) {
+    case ProcessSort::kCpu:
+      return -process.CpuUtilization();
+    case ProcessSort::kRam:
+      return -(double)process.Values().vm_rss;
+    case ProcessSort::kTime:
+      // Longest running first
+      return (double)process.StartTimeTicks();
+    case ProcessSort::kPid:
+      return process.Pid();
+    case ProcessSort::kUser:
+      return user_order[process.Values().user];
+  }
+  return 0;
+}
+
 vector<Process>& System::Processes() {
-  processes_.clear();
-  vector<ProcessValues> process_list = LinuxParser::ProcessValuesList();
+  listed_.clear();
+  // Nothing from the previous refresh is still using scratch memory
+  scratch_.Reset();
+  // Commands of exited processes stay in the string pool, so rebuild it
+  // from the live processes once they make up most of it
+  if (parse_context_.strings.Size() > 2 * known_.size() + 4096) {
+    CompactStrings();
+  }
+  std::pmr::vector<int> pids(scratch_.Resource());
+  LinuxParser::Pids(pids);
+  if (!std::is_sorted(pids.begin(), pids.end())) {
+    std::sort(pids.begin(), pids.end());
+  }
+  PidDiff diff(scratch_.Resource());
+  DiffPids(known_pids_, pids, diff);
+  LinuxParser::RefreshUserNames(parse_context_);
 
-  long system_uptime = LinuxParser::UpTime();
+  double system_uptime = LinuxParser::PreciseUpTime();
+  scheduler_.BeginTick();
 
-  for (auto const& pv : process_list) {
-    if (process_by_pid_.find(pv.pid) != process_by_pid_.end()) {
-      Process process = process_by_pid_.find(pv.pid)->second;
-      process.Update(system_uptime, pv);
-      processes_.push_back(process);
+  // Exited processes return their history slots to the arena
+  for (size_t i : diff.exited) {
+    history_.Release(known_[i].HistorySlot());
+  }
+  // Decide which processes are due first, so that all of their files
+  // can be read as one batch. The rest only have their stat files probed
+  std::pmr::vector<int> due(scratch_.Resource());
+  std::pmr::vector<int> probe(scratch_.Resource());
+  bool probing = scheduler_.Probing();
+  for (size_t i = 0; i < pids.size(); ++i) {
+    size_t previous = diff.previous[i];
+    if (previous == PidDiff::kBorn ||
+        scheduler_.Due(known_[previous].Sampling(), pids[i],
+                       known_[previous].CpuUtilization())) {
+      due.push_back(pids[i]);
+    } else if (probing) {
+      probe.push_back(pids[i]);
+    }
+  }
+  std::pmr::vector<ProcessValues> due_values(scratch_.Resource());
+  std::pmr::vector<char> read(scratch_.Resource());
+  reader_.Read(parse_context_, due, due_values, read);
+  std::pmr::vector<ProcessValues> probe_values(scratch_.Resource());
+  std::pmr::vector<char> probed(scratch_.Resource());
+  bool read_status = parse_context_.read_status;
+  bool read_command_lines = parse_context_.read_command_lines;
+  parse_context_.read_status = false;
+  parse_context_.read_command_lines = false;
+  parse_context_.probe = true;
+  reader_.Read(parse_context_, probe, probe_values, probed);
+  parse_context_.read_status = read_status;
+  parse_context_.read_command_lines = read_command_lines;
+  parse_context_.probe = false;
+
+  // Build the next pid ordered list from the diff, moving continuing
+  // processes across so that nothing needs to be looked up by pid
+  next_.clear();
+  next_pids_.clear();
+  size_t next_due = 0;
+  size_t next_probe = 0;
+  for (size_t i = 0; i < pids.size(); ++i) {
+    int pid = pids[i];
+    size_t previous = diff.previous[i];
+    if (next_probe < probe.size() && probe[next_probe] == pid) {
+      Process& process = known_[previous];
+      bool was_read = probed[next_probe];
+      ProcessValues& pv = probe_values[next_probe++];
+      if (was_read && process.StartTimeTicks() == pv.starttime_ticks) {
+        KeepUnprobed(process.Values(), pv);
+        process.Update(system_uptime, pv);
+        scheduler_.Probed(process.Sampling(), process.CpuUtilization());
+      } else {
+        // Exited or reused, which will be noticed when the pid is next due
+        process.Age(system_uptime);
+        scheduler_.Skipped();
+      }
+      next_.push_back(std::move(process));
+    } else if (next_due == due.size() || due[next_due] != pid) {
+      // Quiet processes are not read on every tick. A reused pid will be
+      // noticed the next time the process is due
+      Process& process = known_[previous];
+      process.Age(system_uptime);
+      scheduler_.Skipped();
+      next_.push_back(std::move(process));
     } else {
-      Process process(system_uptime, pv);
-      processes_.push_back(process);
+      bool was_read = read[next_due];
+      ProcessValues& pv = due_values[next_due++];
+      if (!was_read) {
+        // Exited since it was listed
+        if (previous != PidDiff::kBorn) {
+          history_.Release(known_[previous].HistorySlot());
+        }
+        continue;
+      }
+      if (previous != PidDiff::kBorn &&
+          known_[previous].StartTimeTicks() == pv.starttime_ticks) {
+        Process& process = known_[previous];
+        KeepUnread(process.Values(), pv);
+        process.Update(system_uptime, pv);
+        scheduler_.Sampled(process.Sampling(), pid, process.CpuUtilization());
+        next_.push_back(std::move(process));
+      } else {
+        if (previous != PidDiff::kBorn) {
+          // The pid has been reused since the last refresh
+          history_.Release(known_[previous].HistorySlot());
+        }
+        Process process(system_uptime, pv, parse_context_.strings);
+        process.HistorySlot(history_.Acquire());
+        scheduler_.Born(process.Sampling());
+        next_.push_back(std::move(process));
+      }
     }
+    Process& process = next_.back();
+    history_.Push(process.HistorySlot(), process.CpuUtilization(),
+                  process.RssKb());
+    next_pids_.push_back(pid);
+  }
+  known_.swap(next_);
+  known_pids_.swap(next_pids_);
+
+  for (Process& process : known_) {
+    listed_.push_back(&process);
+  }
+  Order();
+  if (limits_.top_k > 0) {
+    CutOff();
+  }
+  devices_.Update();
+  LinuxParser::LoadValues load;
+  LinuxParser::Load(load_buffer_, load);
+  load_.cpu = cpu_.Utilization(load.cpu);
+  load_.memory = MemoryUtilization(load.memory);
+  load_.running = load.running;
+  load_.total = load.total;
+  alerts_.Evaluate(load_.cpu, load_.memory, load_.running, load_.total,
+                   processes_);
+  store_.Record(load_.cpu, load_.memory, load_.running, processes_,
+                parse_context_.strings);
+  return processes_;
+}
+
+void System::Limit(SamplingLimits const& limits) {
+  limits_ = limits;
+  parse_context_.read_status = limits.status;
+  parse_context_.read_command_lines = limits.command_lines;
+  if (limits.top_k == 0) {
+    scheduler_.Cutoff(-1.0f);
+  }
+}
+
+SamplingLimits const& System::Limits() const { return limits_; }
+
+void System::KeepUnread(ProcessValues const& previous,
+                        ProcessValues& current) const {
+  if (!limits_.status) {
+    current.user_id = previous.user_id;
+    current.user = previous.user;
+    current.vm_size = previous.vm_size;
+    current.vm_rss = previous.vm_rss;
   }
+  if (!limits_.command_lines) {
+    current.command = previous.command;
+  }
+}
 
-  // Clear the process map and re-add to prevent a slow memory leak
-  // due to exited processes never being cleaned up
-  process_by_pid_.clear();
-  for (auto const& process : processes_) {
-    process_by_pid_.emplace(process.Pid(), process);
+void System::KeepUnprobed(ProcessValues const& previous,
+                          ProcessValues& current) {
+  current.user_id = previous.user_id;
+  current.user = previous.user;
+  current.vm_size = previous.vm_size;
+  current.vm_rss = previous.vm_rss;
+  current.command = previous.command;
+}
+
+void System::CutOff() {
+  std::pmr::vector<float> utilizations(scratch_.Resource());
+  utilizations.reserve(known_.size());
+  for (auto const& process : known_) {
+    utilizations.push_back(process.CpuUtilization());
+  }
+  if (utilizations.size() <= limits_.top_k) {
+    scheduler_.Cutoff(-1.0f);
+    return;
   }
+  auto kth = utilizations.begin() + (limits_.top_k - 1);
+  std::nth_element(utilizations.begin(), kth, utilizations.end(),
+                   std::greater<float>());
+  scheduler_.Cutoff(*kth);
+}
 
-  std::sort(processes_.begin(), processes_.end());
+vector<Process>& System::Adopt(vector<ProcessValues> values,
+                              StringPool const& strings) {
+  std::sort(values.begin(), values.end(),
+            [](ProcessValues const& a, ProcessValues const& b) {
+              return a.pid < b.pid;
+            });
+  double system_uptime = LinuxParser::PreciseUpTime();
+  for (Process const& process : known_) {
+    history_.Release(process.HistorySlot());
+  }
+  known_.clear();
+  known_pids_.clear();
+  listed_.clear();
+  for (ProcessValues& pv : values) {
+    pv.user = parse_context_.strings.Intern(strings.View(pv.user));
+    pv.command = parse_context_.strings.Intern(strings.View(pv.command));
+    known_.emplace_back(system_uptime, pv, parse_context_.strings);
+    known_pids_.push_back(pv.pid);
+  }
+  for (Process& process : known_) {
+    listed_.push_back(&process);
+  }
+  Order();
   return processes_;
 }
 
+void System::Sort(ProcessSort key) {
+  sort_ = key;
+  Order();
+}
+
+ProcessSort System::SortKey() const { return sort_; }
+
+void System::Order() {
+  // Put every process back where it was on the previous refresh, with new
+  // processes at the end. Exited processes leave gaps which are skipped
+  ranked_.assign(ranked_.size(), nullptr);
+  displaced_.clear();
+  for (Process* process : listed_) {
+    size_t rank = process->Rank();
+    if (rank < ranked_.size() && ranked_[rank] == nullptr) {
+      ranked_[rank] = process;
+    } else {
+      displaced_.push_back(process);
+    }
+  }
+  size_t count = 0;
+  for (Process* process : ranked_) {
+    if (process != nullptr) {
+      ranked_[count++] = process;
+    }
+  }
+  ranked_.resize(count);
+  ranked_.insert(ranked_.end(), displaced_.begin(), displaced_.end());
+
+  // Users are few, so their names are compared once here rather than on
+  // every comparison of the sort
+  StringPool const& strings = parse_context_.strings;
+  if (sort_ == ProcessSort::kUser) {
+    user_order_.assign(strings.Size(), 0);
+    users_.clear();
+    for (Process* process : ranked_) {
+      StringPool::Id user = process->Values().user;
+      if (user_order_[user] == 0) {
+        user_order_[user] = 1;
+        users_.push_back(user);
+      }
+    }
+    std::sort(users_.begin(), users_.end(),
+              [&strings](StringPool::Id a, StringPool::Id b) {
+                return strings.View(a) < strings.View(b);
+              });
+    for (size_t i = 0; i < users_.size(); ++i) {
+      user_order_[users_[i]] = (std::uint32_t)i;
+    }
+  }
+  // The sort compares these entries, which sit together in one array,
+  // rather than reaching into each process
+  entries_.clear();
+  for (Process* process : ranked_) {
+    entries_.push_back({SortValue(sort_, *process, user_order_),
+                        process->Rank(), process->Pid(), process});
+  }
+  // Ties keep the previous refresh's order, with new processes by pid, so
+  // that equal processes do not swap places from one refresh to the next
+  AdaptiveSort(entries_, kept_entries_, displaced_entries_,
+               [](SortEntry const& a, SortEntry const& b) {
+                 if (a.value != b.value) {
+                   return a.value < b.value;
+                 }
+                 if (a.rank != b.rank) {
+                   return a.rank < b.rank;
+                 }
+                 return a.pid < b.pid;
+               });
+  processes_.clear();
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    entries_[i].process->Rank(i);
+    processes_.push_back(*entries_[i].process);
+  }
+}
+
+void System::CompactStrings() {
+  StringPool strings{};
+  for (auto& process : known_) {
+    process.Reintern(strings);
+  }
+  // Processes keep pointing at the context's pool, which now holds
+  // only their strings
+  parse_context_.strings = std::move(strings);
+  parse_context_.user_by_uid.clear();
+  parse_context_.passwd_mtime_ns = -1;
+}
+
 std::string System::Kernel() { return LinuxParser::Kernel(); }
 
 float System::MemoryUtilization() {
-  // calculation based on answer given at https://stackoverflow.com/a/41251290
   MemoryValues values{};
   LinuxParser::MemoryUtilization(values);
+  return MemoryUtilization(values);
+}
+
+float System::MemoryUtilization(MemoryValues const& values) {
+  // calculation based on answer given at https://stackoverflow.com/a/41251290
   return (float)(values.total - values.free) /
          std::max((float)values.total, 1.0f);
 }
 
+SystemPressure System::Pressure() {
+  SystemPressure pressure{};
+  pressure.available =
+      LinuxParser::Pressure(LinuxParser::kCpuPressureFilename, pressure.cpu);
+  LinuxParser::Pressure(LinuxParser::kMemoryPressureFilename, pressure.memory);
+  LinuxParser::Pressure(LinuxParser::kIoPressureFilename, pressure.io);
+  return pressure;
+}
+
 std::string System::OperatingSystem() { return LinuxParser::OperatingSystem(); }
 
 int System::RunningProcesses() { return LinuxParser::RunningProcesses(); }
@@ -0,0 +1,124 @@
+// Evaluates 1,000 random rules over 20,000 synthetic processes and checks
+// that every tick fits inside the one second sampling interval
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "alert_engine.h"
+#include "check.h"
+
+static const int kRules = 1000;
+static const int kProcesses = 20000;
+static const int kTicks = 20;
+
+/**
+ * The sampling interval each tick must fit in, in seconds
+ */
+static const double kInterval = 1.0;
+
+/**
+ * Write kRules random rules to path. Process rules look for unusually high
+ * use, as rules matching most processes would be of little use
+ * @param path
+ * @param random
+ */
+static void WriteRules(std::string const& path, std::mt19937& random) {
+  static char const* const system_metrics[] = {"cpu", "memory", "running",
+                                               "total"};
+  static char const* const ops[] = {">", ">=", "<", "<="};
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  for (int rule = 0; rule < kRules; ++rule) {
+    int seconds = random() % 60;
+    if (random() % 10 == 0) {
+      std::fprintf(file, "rule%d system %s %s %d%% %ds log:/dev/null\n", rule,
+                   system_metrics[random() % 4], ops[random() % 4],
+                   (int)(random() % 100), seconds);
+    } else if (random() % 2 == 0) {
+      std::fprintf(file, "rule%d process cpu %s %d%% %ds log:/dev/null\n",
+                   rule, ops[random() % 2], (int)(10 + random() % 90),
+                   seconds);
+    } else {
+      std::fprintf(file, "rule%d process rss %s %dM %ds log:/dev/null\n",
+                   rule, ops[random() % 2], (int)(64 + random() % 2048),
+                   seconds);
+    }
+  }
+  std::fclose(file);
+}
+
+/**
+ * Set a random load on a process. Most processes are idle and small, and
+ * one in twenty is busy or large
+ * @param load the memory use and cpu ticks used per second
+ * @param random
+ */
+static void Load(ProcessValues& load, std::mt19937& random) {
+  load.vm_rss = random() % 20 == 0 ? random() % (4 * 1024 * 1024)
+                                   : random() % (64 * 1024);
+  load.utime_ticks = random() % 20 == 0 ? random() % 100 : random() % 2;
+}
+
+int main() {
+  std::mt19937 random(29);
+  char path[] = "/tmp/alert_engine_benchmarkXXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  WriteRules(path, random);
+  AlertEngine engine;
+  std::string error;
+  bool compiled = AlertEngine::Compile(path, engine, error);
+  std::remove(path);
+  if (!compiled) {
+    std::cerr << error << "\n";
+  }
+  CHECK(compiled);
+  CHECK(engine.Rules() == (std::size_t)kRules);
+
+  StringPool strings;
+  std::vector<Process> processes;
+  std::vector<ProcessValues> values(kProcesses);
+  std::vector<ProcessValues> loads(kProcesses);
+  processes.reserve(kProcesses);
+  for (int i = 0; i < kProcesses; ++i) {
+    values[i].pid = i + 1;
+    processes.emplace_back(0.0, values[i], strings);
+  }
+
+  double slowest = 0;
+  double total = 0;
+  for (int tick = 1; tick <= kTicks; ++tick) {
+    double now = tick * kInterval;
+    for (int i = 0; i < kProcesses; ++i) {
+      // Most processes keep their load, a few change it each tick
+      if (tick == 1 || random() % 20 == 0) {
+        Load(loads[i], random);
+      }
+      values[i].vm_rss = loads[i].vm_rss;
+      values[i].utime_ticks += loads[i].utime_ticks;
+      processes[i].Update(now, values[i]);
+    }
+    double system_values[5] = {0.5, 0.9, 8, 20000, 0};
+    auto start = std::chrono::steady_clock::now();
+    engine.Evaluate(now, system_values, processes);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    slowest = std::max(slowest, seconds);
+    total += seconds;
+  }
+  std::cout << kRules << " rules over " << kProcesses << " processes: "
+            << total / kTicks * 1000 << " ms per tick on average, "
+            << slowest * 1000 << " ms at most, " << engine.Firing()
+            << " alerts firing\n";
+  CHECK(slowest < kInterval);
+  return CheckResult();
+}
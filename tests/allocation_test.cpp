@@ -0,0 +1,79 @@
+// Counts heap allocations made by System::Processes() once the process
+// list has settled. Refreshes in which a process was born or exited may
+// allocate for its strings and history, so only refreshes which saw the
+// same pids as the one before are required to make none
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "check.h"
+#include "system.h"
+
+static bool counting = false;
+static long allocations = 0;
+
+void* operator new(std::size_t size) {
+  if (counting) {
+    ++allocations;
+  }
+  void* memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+/**
+ * Refreshes to settle before counting, so that every buffer has grown to
+ * its steady state size
+ */
+static const int kWarmUp = 10;
+
+/**
+ * Refreshes counted
+ */
+static const int kTicks = 40;
+
+int main() {
+  System system;
+  std::vector<int> previous;
+  std::vector<int> current;
+  previous.reserve(1 << 16);
+  current.reserve(1 << 16);
+  for (int tick = 0; tick < kWarmUp; ++tick) {
+    system.Processes();
+  }
+
+  int steady = 0;
+  for (int tick = 0; tick < kTicks; ++tick) {
+    allocations = 0;
+    counting = true;
+    std::vector<Process>& processes = system.Processes();
+    counting = false;
+    current.clear();
+    for (Process const& process : processes) {
+      current.push_back(process.Pid());
+    }
+    std::sort(current.begin(), current.end());
+    if (tick > 0 && current == previous) {
+      ++steady;
+      if (allocations != 0) {
+        std::cerr << "tick " << tick << ": " << allocations
+                  << " allocations with " << current.size()
+                  << " unchanged processes\n";
+      }
+      CHECK(allocations == 0);
+    }
+    previous.swap(current);
+  }
+  std::cout << steady << " of " << kTicks << " refreshes were steady\n";
+  // A busy machine may never be steady, but most refreshes should be
+  CHECK(steady >= kTicks / 4);
+  return CheckResult();
+}
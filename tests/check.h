@@ -0,0 +1,30 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+
+/**
+ * Number of failed checks in this test program
+ */
+inline int check_failures = 0;
+
+/**
+ * Report a failed condition and carry on, so that one run shows every
+ * failure. main returns CheckResult()
+ */
+#define CHECK(condition)                                             \
+  do {                                                               \
+    if (!(condition)) {                                              \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " \
+                << #condition << "\n";                               \
+      ++check_failures;                                              \
+    }                                                                \
+  } while (0)
+
+/**
+ * The exit status of a test program
+ * @return
+ */
+inline int CheckResult() { return check_failures == 0 ? 0 : 1; }
+
+#endif
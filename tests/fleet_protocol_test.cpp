@@ -0,0 +1,269 @@
+// Round trips snapshots through the encoder and a FleetHost, checks that
+// malformed frames are rejected, then runs many agents against a local
+// aggregator on loopback and reports its throughput
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "fleet_agent.h"
+#include "fleet_aggregator.h"
+#include "fleet_protocol.h"
+#include "system.h"
+
+using FleetProtocol::FrameReader;
+using FleetProtocol::FrameWriter;
+
+/**
+ * Apply every frame in out to host, as the aggregator would
+ * @param out
+ * @param host
+ * @param strings
+ * @return
+ */
+static bool ApplyFrames(std::vector<std::uint8_t> const& out,
+                        FleetHost& host, StringPool& strings) {
+  std::size_t offset = 0;
+  while (offset < out.size()) {
+    std::size_t length = 0;
+    for (std::size_t i = 0; i < FleetProtocol::kHeaderSize; ++i) {
+      length |= (std::size_t)out[offset + i] << (8 * i);
+    }
+    FrameReader reader(out.data() + offset + FleetProtocol::kHeaderSize,
+                       length);
+    if (reader.Byte() != FleetProtocol::kSnapshot ||
+        !host.Apply(reader, strings)) {
+      return false;
+    }
+    offset += FleetProtocol::kHeaderSize + length;
+  }
+  return true;
+}
+
+/**
+ * Does the host hold exactly the provided processes?
+ * @param host
+ * @param host_strings
+ * @param processes
+ * @param strings
+ * @return
+ */
+static bool Matches(FleetHost const& host, StringPool const& host_strings,
+                    std::vector<Process> const& processes,
+                    StringPool const& strings) {
+  if (host.processes.size() != processes.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < processes.size(); ++i) {
+    FleetProcess const& decoded = host.processes[i];
+    ProcessValues const& values = processes[i].Values();
+    if (decoded.pid != values.pid || decoded.vm_rss != values.vm_rss ||
+        decoded.vm_size != values.vm_size ||
+        decoded.utime_ticks != values.utime_ticks ||
+        decoded.starttime_ticks != values.starttime_ticks ||
+        host_strings.View(decoded.user) != strings.View(values.user) ||
+        host_strings.View(decoded.command) != strings.View(values.command)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Values of a synthetic process
+ * @param pid
+ * @param strings
+ * @param user
+ * @param command
+ * @return
+ */
+static ProcessValues Values(int pid, StringPool& strings,
+                            std::string const& user,
+                            std::string const& command) {
+  ProcessValues values;
+  values.pid = pid;
+  values.user = strings.Intern(user);
+  values.command = strings.Intern(command);
+  values.vm_size = 1000 * pid;
+  values.vm_rss = 100 * pid;
+  values.starttime_ticks = pid;
+  return values;
+}
+
+static void TestRoundTrip() {
+  FleetProtocol::Encoder encoder;
+  FleetProtocol::SystemValues system;
+  FleetHost host;
+  StringPool host_strings;
+  std::vector<std::uint8_t> out;
+
+  StringPool strings;
+  std::vector<Process> processes;
+  for (int pid : {1, 7, 300, 70000}) {
+    processes.emplace_back(
+        0.0, Values(pid, strings, "root", "cmd" + std::to_string(pid)),
+        strings);
+  }
+  encoder.Snapshot(system, processes, strings, out);
+  CHECK(ApplyFrames(out, host, host_strings));
+  CHECK(Matches(host, host_strings, processes, strings));
+
+  // One exits, one is born and one changes
+  processes.erase(processes.begin() + 1);
+  processes.emplace_back(0.0, Values(70001, strings, "daemon", "new"),
+                         strings);
+  ProcessValues changed = processes[0].Values();
+  changed.vm_rss = 5;
+  changed.utime_ticks = 123;
+  processes[0].Update(1.0, changed);
+  out.clear();
+  encoder.Snapshot(system, processes, strings, out);
+  CHECK(ApplyFrames(out, host, host_strings));
+  CHECK(Matches(host, host_strings, processes, strings));
+
+  // Nothing changed costs only the frame's header and system values
+  std::size_t empty_size = out.size();
+  out.clear();
+  encoder.Snapshot(system, processes, strings, out);
+  CHECK(out.size() < empty_size);
+  CHECK(ApplyFrames(out, host, host_strings));
+  CHECK(Matches(host, host_strings, processes, strings));
+}
+
+static void TestRecycledIds() {
+  // The first strings interned into a fresh pool get the same ids as in
+  // the old one, so a change of user and command would be invisible if
+  // only ids were compared
+  FleetProtocol::Encoder encoder;
+  FleetProtocol::SystemValues system;
+  FleetHost host;
+  StringPool host_strings;
+  std::vector<std::uint8_t> out;
+
+  StringPool before;
+  std::vector<Process> processes;
+  processes.emplace_back(0.0, Values(42, before, "alice", "vim"), before);
+  encoder.Snapshot(system, processes, before, out);
+
+  StringPool after;
+  std::vector<Process> compacted;
+  compacted.emplace_back(0.0, Values(42, after, "bob", "emacs"), after);
+  CHECK(compacted[0].Values().user == processes[0].Values().user);
+  CHECK(compacted[0].Values().command == processes[0].Values().command);
+  encoder.Snapshot(system, compacted, after, out);
+  CHECK(ApplyFrames(out, host, host_strings));
+  CHECK(Matches(host, host_strings, compacted, after));
+}
+
+static void TestMalformed() {
+  StringPool strings;
+  std::vector<std::uint8_t> out;
+  FrameWriter writer(out);
+  // Pids whose deltas add up past the largest int
+  writer.Begin(FleetProtocol::kSnapshot);
+  for (int system_value = 0; system_value < 5; ++system_value) {
+    writer.Varint(0);
+  }
+  writer.Varint(2);
+  writer.Varint(2000000000);
+  writer.Varint(2000000000);
+  writer.Varint(0);
+  writer.Varint(0);
+  writer.End();
+  FleetHost host;
+  CHECK(!ApplyFrames(out, host, strings));
+
+  // A pid which does not increase
+  out.clear();
+  writer.Begin(FleetProtocol::kSnapshot);
+  for (int system_value = 0; system_value < 5; ++system_value) {
+    writer.Varint(0);
+  }
+  writer.Varint(0);
+  writer.Varint(2);
+  writer.Varint(10);
+  writer.Byte(0);
+  writer.Varint(0);
+  writer.End();
+  FleetHost other;
+  CHECK(!ApplyFrames(out, other, strings));
+}
+
+/**
+ * Agents run against the aggregator on loopback
+ */
+static const int kAgents = 50;
+
+/**
+ * Snapshots each agent sends
+ */
+static const int kTicks = 5;
+
+static void TestLoopback() {
+  FleetAggregator aggregator;
+  std::string error;
+  int port = 0;
+  for (int attempt = 0; attempt < 100 && port == 0; ++attempt) {
+    int candidate = 40000 + (getpid() + attempt * 97) % 20000;
+    if (aggregator.Listen(candidate, error)) {
+      port = candidate;
+    }
+  }
+  CHECK(port != 0);
+  if (port == 0) {
+    std::cerr << error << "\n";
+    return;
+  }
+
+  // Each agent samples its own System, as on separate hosts
+  std::vector<std::unique_ptr<System>> systems;
+  std::vector<std::unique_ptr<FleetAgent>> agents;
+  for (int i = 0; i < kAgents; ++i) {
+    systems.push_back(std::make_unique<System>());
+    agents.push_back(std::make_unique<FleetAgent>("127.0.0.1", port));
+  }
+  // Agents connect in the background, so their first snapshots may only
+  // go out with their second
+  aggregator.ResetCounters();
+  double seconds = 0;
+  for (int tick = 0; tick < kTicks; ++tick) {
+    for (int i = 0; i < kAgents; ++i) {
+      agents[i]->Send(*systems[i]);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::size_t expected = (std::size_t)kAgents * tick;
+    for (int pump = 0; pump < 100 && aggregator.Snapshots() < expected;
+         ++pump) {
+      aggregator.Pump(10);
+    }
+    seconds += std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+  }
+  std::size_t snapshots = aggregator.Snapshots();
+  std::cout << kAgents << " agents on loopback: " << snapshots
+            << " snapshots at " << (long)(snapshots / seconds)
+            << " snapshots/s, "
+            << aggregator.Bytes() / std::max(snapshots, (std::size_t)1)
+            << " bytes/host/tick\n";
+  CHECK(aggregator.Hosts() == (std::size_t)kAgents);
+  CHECK(snapshots >= (std::size_t)kAgents * (kTicks - 1));
+  CHECK(aggregator.Processes() > 0);
+  for (auto const& agent : agents) {
+    CHECK(agent->Queued() == 0);
+  }
+}
+
+int main() {
+  TestRoundTrip();
+  TestRecycledIds();
+  TestMalformed();
+  TestLoopback();
+  return CheckResult();
+}
@@ -0,0 +1,260 @@
+// Rolls synthetic samples up through a history store and checks that
+// minutes are written as soon as they end, without waiting for a full
+// block or Close, and that a process which is never quite among the
+// busiest of a second can still be the busiest of its minute. Then checks
+// that segments past their tier's retention are deleted, and that a query
+// for a few seconds of a full segment only reads the block holding them
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "history_store.h"
+
+/**
+ * Processes busier than the steady one in every second, each busy for
+ * only that second
+ */
+static const int kBursts = (int)HistoryStore::kTopK;
+
+/**
+ * A sample at time in which the steady process is just outside the kTopK
+ * busiest
+ * @param time
+ * @return
+ */
+static HistoryRow Sample(long time) {
+  HistoryRow sample;
+  sample.time = time;
+  sample.samples = 1;
+  for (auto& metric : sample.metrics) {
+    metric = {0.5, 0.5, 0.5};
+  }
+  for (int burst = 0; burst < kBursts; ++burst) {
+    sample.top.push_back({(int)(1000 + time % 3600 * kBursts + burst), "root",
+                          "burst", 0.5, 1});
+  }
+  sample.top.push_back({42, "root", "steady", 0.4, 1});
+  return sample;
+}
+
+/**
+ * Queries of the narrow range which are timed, keeping the fastest
+ */
+static const int kRuns = 20;
+
+/**
+ * Make an empty store directory under TMPDIR. Returns an empty string if
+ * it can not be made
+ * @return
+ */
+static std::string MakeStore() {
+  char const* temporary = getenv("TMPDIR");
+  std::string pattern =
+      std::string(temporary != nullptr ? temporary : "/tmp") +
+      "/history_store_XXXXXX";
+  if (mkdtemp(pattern.data()) == nullptr) {
+    return "";
+  }
+  return pattern;
+}
+
+static void RemoveStore(std::string const& directory) {
+  std::string command = "rm -rf '" + directory + "'";
+  CHECK(system(command.c_str()) == 0);
+}
+
+/**
+ * The path of a segment's file in the store in directory
+ * @param directory
+ * @param tier
+ * @param segment
+ * @param extension
+ * @return
+ */
+static std::string SegmentPath(std::string const& directory, std::size_t tier,
+                               long segment, char const* extension) {
+  return directory + "/" + HistoryStore::kTierNames[tier] + "/" +
+         std::to_string(segment) + extension;
+}
+
+/**
+ * Write an empty segment and index, as a long stopped monitor might have
+ * left behind
+ * @param directory
+ * @param tier
+ * @param segment
+ */
+static void MakeSegment(std::string const& directory, std::size_t tier,
+                        long segment) {
+  std::ofstream(SegmentPath(directory, tier, segment, ".seg"));
+  std::ofstream(SegmentPath(directory, tier, segment, ".idx"));
+}
+
+static bool Exists(std::string const& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+/**
+ * Start of the segment of tier just old enough to be deleted at now, or
+ * with newest set, of the oldest one which must be kept
+ * @param tier
+ * @param now
+ * @param newest
+ * @return
+ */
+static long Segment(std::size_t tier, long now, bool newest) {
+  long span = HistoryStore::kSegmentSpans[tier];
+  long cutoff = now - HistoryStore::kRetentions[tier];
+  return cutoff - cutoff % span + (newest ? span : -span);
+}
+
+static void CheckMinutes(std::string const& directory) {
+  std::string error;
+  HistoryStore store;
+  CHECK(store.Open(directory, error));
+
+  // Two minutes and a second of samples, starting on an hour so that
+  // nothing but the minute boundaries can cause a write
+  long start = std::time(nullptr) / 3600 * 3600 - 3600;
+  for (long time = start; time <= start + 120; ++time) {
+    store.Add(Sample(time));
+  }
+
+  // Both minutes are on disk while the store is still open
+  std::vector<HistoryRow> seconds;
+  std::vector<HistoryRow> minutes;
+  CHECK(HistoryStore::Query(directory, 0, start, start + 3600, seconds,
+                            error));
+  CHECK(HistoryStore::Query(directory, 1, start, start + 3600, minutes,
+                            error));
+  std::cout << seconds.size() << " seconds and " << minutes.size()
+            << " minutes written before Close\n";
+  CHECK(seconds.size() == 120);
+  CHECK(minutes.size() == 2);
+
+  // The steady process is trimmed from every second, but over a minute
+  // each burst only averages 0.5 / 60
+  for (HistoryRow const& second : seconds) {
+    CHECK(second.top.size() == HistoryStore::kTopK);
+    CHECK(second.top.back().command == "burst");
+  }
+  for (HistoryRow const& minute : minutes) {
+    CHECK(minute.samples == 60);
+    CHECK(!minute.top.empty() && minute.top.front().pid == 42 &&
+          minute.top.front().cpu > 0.39);
+  }
+  store.Close();
+}
+
+static void CheckRetention(std::string const& directory) {
+  std::string error;
+  HistoryStore store;
+  // Create the tier directories, then leave segments either side of each
+  // tier's retention as if the store had been written long ago
+  CHECK(store.Open(directory, error));
+  store.Close();
+  long now = std::time(nullptr);
+  for (std::size_t tier = 0; tier < HistoryStore::kTiers; ++tier) {
+    MakeSegment(directory, tier, Segment(tier, now, false));
+    MakeSegment(directory, tier, Segment(tier, now, true));
+  }
+
+  // Opening the store deletes the expired ones
+  CHECK(store.Open(directory, error));
+  for (std::size_t tier = 0; tier < HistoryStore::kTiers; ++tier) {
+    long expired = Segment(tier, now, false);
+    long kept = Segment(tier, now, true);
+    CHECK(!Exists(SegmentPath(directory, tier, expired, ".seg")));
+    CHECK(!Exists(SegmentPath(directory, tier, expired, ".idx")));
+    CHECK(Exists(SegmentPath(directory, tier, kept, ".seg")));
+    CHECK(Exists(SegmentPath(directory, tier, kept, ".idx")));
+  }
+
+  // So does starting a segment while the store is open, measured from the
+  // time of the samples being written
+  long start = now / 3600 * 3600 - 3600;
+  long expired = Segment(0, start, false);
+  MakeSegment(directory, 0, expired);
+  for (long time = start; time <= start + 60; ++time) {
+    store.Add(Sample(time));
+  }
+  CHECK(!Exists(SegmentPath(directory, 0, expired, ".seg")));
+  CHECK(!Exists(SegmentPath(directory, 0, expired, ".idx")));
+  CHECK(Exists(SegmentPath(directory, 0, start, ".seg")));
+  store.Close();
+}
+
+/**
+ * Fastest of kRuns queries of [from, to) of the seconds tier, in seconds
+ * @param directory
+ * @param from
+ * @param to
+ * @param rows
+ * @return
+ */
+static double TimeQuery(std::string const& directory, long from, long to,
+                        std::vector<HistoryRow>& rows) {
+  std::string error;
+  double fastest = 1e9;
+  for (int run = 0; run < kRuns; ++run) {
+    auto begin = std::chrono::steady_clock::now();
+    CHECK(HistoryStore::Query(directory, 0, from, to, rows, error));
+    fastest = std::min(fastest, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - begin)
+                                    .count());
+  }
+  return fastest;
+}
+
+static void CheckNarrowQuery(std::string const& directory) {
+  std::string error;
+  HistoryStore store;
+  CHECK(store.Open(directory, error));
+  // A whole segment of seconds, written as a block a minute
+  long start = std::time(nullptr) / 3600 * 3600 - 3600;
+  for (long time = start; time < start + 3600; ++time) {
+    store.Add(Sample(time));
+  }
+  store.Close();
+
+  // Half a minute in the middle of the hour lies in a single block, so
+  // the index lets the query skip the other 59
+  std::vector<HistoryRow> narrow;
+  std::vector<HistoryRow> hour;
+  double narrow_seconds =
+      TimeQuery(directory, start + 1800, start + 1830, narrow);
+  double hour_seconds = TimeQuery(directory, start, start + 3600, hour);
+  std::cout << "querying 30 of 3600 seconds took " << narrow_seconds * 1e3
+            << " ms, all of them " << hour_seconds * 1e3 << " ms\n";
+  CHECK(narrow.size() == 30);
+  CHECK(!narrow.empty() && narrow.front().time == start + 1800 &&
+        narrow.back().time == start + 1829);
+  CHECK(hour.size() == 3600);
+  CHECK(narrow_seconds * 10 < hour_seconds);
+}
+
+int main() {
+  using Check = void (*)(std::string const&);
+  for (Check check : {CheckMinutes, CheckRetention, CheckNarrowQuery}) {
+    std::string directory = MakeStore();
+    if (directory.empty()) {
+      CHECK(false);
+      return CheckResult();
+    }
+    check(directory);
+    RemoveStore(directory);
+  }
+  return CheckResult();
+}
@@ -0,0 +1,119 @@
+// Puts the overhead governor under a synthetic load whose cost follows
+// what its level leaves sampled, and checks that it settles within its
+// budget, without degrading further than it needs to, and recovers once
+// the load goes away
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "check.h"
+#include "overhead_governor.h"
+#include "refresh_scheduler.h"
+#include "system.h"
+
+using std::chrono::milliseconds;
+
+/**
+ * The governor's cpu budget, as a share of a core
+ */
+static const float kBudget = 0.05f;
+
+/**
+ * Wall time standing in for each second of the refresh interval, so that
+ * a refresh every second takes 50 ms of the test
+ */
+static const int kTimeScale = 20;
+
+/**
+ * Cpu time used by this process so far, in seconds
+ * @return
+ */
+static double CpuSeconds() {
+  timespec time{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+/**
+ * Spin until this process has used seconds of cpu time
+ * @param seconds
+ */
+static void Burn(double seconds) {
+  double until = CpuSeconds() + seconds;
+  while (CpuSeconds() < until) {
+  }
+}
+
+/**
+ * Cpu time a refresh costs with the limits applied. Each limit takes away
+ * a share of the work, as not reading those files would
+ * @param limits
+ * @param full_cost cost of a refresh which samples everything
+ * @return
+ */
+static double Cost(SamplingLimits const& limits, double full_cost) {
+  double cost = full_cost;
+  cost *= limits.command_lines ? 1.0 : 0.6;
+  cost *= limits.status ? 1.0 : 0.6;
+  cost *= limits.top_k == 0 ? 1.0 : 0.3;
+  return cost;
+}
+
+/**
+ * Refresh ticks times, each one costing the load for the governor's level
+ * and lasting the scheduler's interval scaled down by kTimeScale
+ * @param governor
+ * @param system
+ * @param scheduler
+ * @param full_cost
+ * @param ticks
+ * @param max_level set to the highest level seen
+ */
+static void Run(OverheadGovernor& governor, System& system,
+                RefreshScheduler& scheduler, double full_cost, int ticks,
+                int& max_level) {
+  for (int tick = 0; tick < ticks; ++tick) {
+    auto start = std::chrono::steady_clock::now();
+    Burn(Cost(system.Limits(), full_cost));
+    std::this_thread::sleep_until(start + scheduler.Interval() / kTimeScale);
+    governor.Update();
+    governor.Apply(system, scheduler);
+    max_level = std::max(max_level, governor.Level());
+  }
+}
+
+int main() {
+  System system;
+  OverheadGovernor governor(kBudget, 0);
+  RefreshScheduler scheduler(milliseconds(1000), milliseconds(1000));
+  governor.Apply(system, scheduler);
+
+  // A full refresh costs 10 ms of each 50 ms, 20% of a core. Refreshing
+  // half as often and leaving out command lines and status files brings
+  // it to 3.6%, so the governor should settle at level 3
+  int max_level = 0;
+  Run(governor, system, scheduler, 0.010, 20, max_level);
+  int settled = governor.Level();
+  int after_settling = 0;
+  Run(governor, system, scheduler, 0.010, 20, after_settling);
+  std::cout << "under load: settled at level " << settled << " ("
+            << OverheadGovernor::Describe(settled) << ") using "
+            << governor.CpuUsage() * 100 << "% of a core, budget "
+            << kBudget * 100 << "%\n";
+  CHECK(settled == 3);
+  CHECK(max_level == 3);
+  CHECK(governor.Level() == settled);
+  CHECK(after_settling == settled);
+  CHECK(governor.CpuUsage() <= kBudget);
+
+  // Once refreshes are cheap again it steps all the way back down
+  Run(governor, system, scheduler, 0.0005, 40, max_level);
+  std::cout << "without load: level " << governor.Level() << " using "
+            << governor.CpuUsage() * 100 << "% of a core\n";
+  CHECK(governor.Level() == 0);
+  return CheckResult();
+}
@@ -0,0 +1,238 @@
+// Lists a synthetic /proc of 100,000 process directories with readdir, as
+// Pids did before, and with getdents64, then diffs 100,000 pids across
+// ticks with the ordered map walk System used before and with DiffPids
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "linux_parser.h"
+#include "pid_diff.h"
+
+static const int kPids = 100000;
+static const int kRuns = 20;
+
+/**
+ * Share of pids which exit, and are replaced by as many births, each tick
+ */
+static const double kChurn = 0.01;
+
+/**
+ * Seconds taken by the fastest of kRuns runs of run
+ * @param run
+ * @return
+ */
+template <typename Run>
+static double Fastest(Run run) {
+  double fastest = 1e9;
+  for (int i = 0; i < kRuns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    fastest = std::min(fastest, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+  }
+  return fastest;
+}
+
+/**
+ * Pids as they were listed before getdents64: readdir, with each name
+ * checked and parsed by std::from_chars
+ * @param path
+ * @param pids
+ */
+static void ReaddirPids(std::string const& path, std::vector<int>& pids) {
+  pids.clear();
+  DIR* directory = opendir(path.c_str());
+  if (directory == nullptr) {
+    return;
+  }
+  struct dirent* file;
+  while ((file = readdir(directory)) != nullptr) {
+    if (file->d_type == DT_DIR) {
+      const char* name = file->d_name;
+      const char* end = name + std::strlen(name);
+      int pid;
+      auto [last, error] = std::from_chars(name, end, pid);
+      if (error == std::errc() && last == end) {
+        pids.push_back(pid);
+      }
+    }
+  }
+  closedir(directory);
+  std::sort(pids.begin(), pids.end());
+}
+
+/**
+ * Make a directory in path for each of kPids pids, and a few which are not
+ * processes
+ * @param path
+ * @return
+ */
+static bool MakeTree(std::string const& path) {
+  for (int pid = 1; pid <= kPids; ++pid) {
+    if (mkdir((path + "/" + std::to_string(pid)).c_str(), 0700) != 0) {
+      return false;
+    }
+  }
+  for (char const* other : {"self", "sys", "12a"}) {
+    mkdir((path + "/" + other).c_str(), 0700);
+  }
+  return true;
+}
+
+static void RemoveTree(std::string const& path) {
+  for (int pid = 1; pid <= kPids; ++pid) {
+    rmdir((path + "/" + std::to_string(pid)).c_str());
+  }
+  for (char const* other : {"self", "sys", "12a"}) {
+    rmdir((path + "/" + other).c_str());
+  }
+  rmdir(path.c_str());
+}
+
+static void BenchmarkListing() {
+  char const* temporary = std::getenv("TMPDIR");
+  std::string pattern =
+      std::string(temporary != nullptr ? temporary : "/tmp") +
+      "/pid_list_XXXXXX";
+  if (mkdtemp(pattern.data()) == nullptr) {
+    CHECK(false);
+    return;
+  }
+  std::string path = pattern;
+  if (!MakeTree(path)) {
+    std::cerr << "could not make " << kPids << " directories in " << path
+              << "\n";
+    CHECK(false);
+    RemoveTree(path);
+    return;
+  }
+
+  std::vector<int> readdir_pids;
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::vector<int> getdents_pids(&arena);
+  double readdir_seconds = Fastest([&] { ReaddirPids(path, readdir_pids); });
+  double getdents_seconds =
+      Fastest([&] { LinuxParser::Pids(getdents_pids, path); });
+  RemoveTree(path);
+
+  std::cout << "listing " << kPids << " pids: readdir "
+            << readdir_seconds * 1e3 << " ms, getdents64 "
+            << getdents_seconds * 1e3 << " ms\n";
+  std::sort(getdents_pids.begin(), getdents_pids.end());
+  CHECK(readdir_pids.size() == (std::size_t)kPids);
+  CHECK(std::equal(readdir_pids.begin(), readdir_pids.end(),
+                   getdents_pids.begin(), getdents_pids.end()));
+}
+
+/**
+ * Ascending pid lists for each tick, with kChurn of the pids replaced by
+ * higher ones every tick
+ * @return
+ */
+static std::vector<std::vector<int>> Ticks() {
+  std::mt19937 random(7);
+  std::vector<std::vector<int>> ticks(kRuns + 1);
+  std::vector<int> pids(kPids);
+  for (int i = 0; i < kPids; ++i) {
+    pids[i] = i + 1;
+  }
+  int next = kPids + 1;
+  for (auto& tick : ticks) {
+    tick = pids;
+    for (int i = 0; i < kPids * kChurn; ++i) {
+      pids[random() % pids.size()] = next++;
+    }
+    std::sort(pids.begin(), pids.end());
+  }
+  return ticks;
+}
+
+static void BenchmarkDiff() {
+  std::vector<std::vector<int>> ticks = Ticks();
+
+  // The map walk erases exited pids and inserts born ones in place, as
+  // System did before DiffPids. The value stands in for a process
+  std::map<int, int> by_pid;
+  long map_exits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto const& pids : ticks) {
+    auto existing = by_pid.begin();
+    for (int pid : pids) {
+      while (existing != by_pid.end() && existing->first < pid) {
+        existing = by_pid.erase(existing);
+        ++map_exits;
+      }
+      if (existing == by_pid.end() || existing->first != pid) {
+        existing = by_pid.emplace_hint(existing, pid, pid);
+      }
+      ++existing;
+    }
+    while (existing != by_pid.end()) {
+      existing = by_pid.erase(existing);
+      ++map_exits;
+    }
+  }
+  double map_seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  // DiffPids, then continuing values moved into the next tick's vector by
+  // index, as System does now
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::vector<int> current(&arena);
+  PidDiff diff(&arena);
+  std::vector<int> known_pids;
+  std::vector<int> known;
+  std::vector<int> next_pids;
+  std::vector<int> next;
+  long diff_exits = 0;
+  start = std::chrono::steady_clock::now();
+  for (auto const& pids : ticks) {
+    current.assign(pids.begin(), pids.end());
+    DiffPids(known_pids, current, diff);
+    diff_exits += diff.exited.size();
+    next.clear();
+    next_pids.clear();
+    for (std::size_t i = 0; i < current.size(); ++i) {
+      next.push_back(diff.previous[i] == PidDiff::kBorn
+                         ? current[i]
+                         : known[diff.previous[i]]);
+      next_pids.push_back(current[i]);
+    }
+    known.swap(next);
+    known_pids.swap(next_pids);
+  }
+  double diff_seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+
+  std::cout << "diffing " << kPids << " pids over " << ticks.size()
+            << " ticks: map " << map_seconds * 1e3 / ticks.size()
+            << " ms/tick, DiffPids " << diff_seconds * 1e3 / ticks.size()
+            << " ms/tick\n";
+  CHECK(map_exits == diff_exits);
+  CHECK(std::equal(known.begin(), known.end(), ticks.back().begin(),
+                   ticks.back().end()));
+  CHECK(diff_seconds < map_seconds);
+}
+
+int main() {
+  BenchmarkListing();
+  BenchmarkDiff();
+  return CheckResult();
+}
@@ -0,0 +1,121 @@
+// Switches sort keys and scrolls through a list of 100,000 processes,
+// drawing each frame into an offscreen terminal the way Display does, and
+// checks that every key is answered within a frame budget. Skipped where
+// no terminal description is available
+
+#include <curses.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "ncurses_display.h"
+#include "system.h"
+
+/**
+ * Exit status which tells ctest the test was skipped
+ */
+static const int kSkipped = 77;
+
+static const int kProcesses = 100000;
+
+/**
+ * Longest a key may take to reach the screen, about what still feels
+ * immediate
+ */
+static const double kMaxFrameMs = 100.0;
+
+/**
+ * Values of kProcesses synthetic processes, some of whose commands hold
+ * printf conversions
+ * @param strings
+ * @return
+ */
+static std::vector<ProcessValues> Values(StringPool& strings) {
+  std::mt19937 random(11);
+  std::vector<ProcessValues> values(kProcesses);
+  for (int i = 0; i < kProcesses; ++i) {
+    ProcessValues& pv = values[i];
+    pv.pid = 1 + i;
+    pv.user = strings.Intern("user" + std::to_string(random() % 50));
+    pv.command = strings.Intern(i % 10 == 0 ? "date +%s %n%n"
+                                            : "worker --id " +
+                                                  std::to_string(i));
+    pv.vm_size = random() % (1 << 22);
+    pv.vm_rss = random() % (1 << 20);
+    pv.utime_ticks = random() % 100000;
+    pv.starttime_ticks = random() % 1000;
+    pv.processor = (int)(random() % 64);
+  }
+  return values;
+}
+
+int main() {
+  setenv("LINES", "50", 1);
+  setenv("COLUMNS", "160", 1);
+  FILE* out = fopen("/dev/null", "w");
+  SCREEN* screen = out != nullptr ? newterm("xterm", out, stdin) : nullptr;
+  if (screen == nullptr) {
+    std::cout << "no terminal to draw into\n";
+    return kSkipped;
+  }
+  WINDOW* window = newwin(45, 160, 0, 0);
+
+  System system;
+  StringPool strings;
+  std::vector<Process>& processes = system.Adopt(Values(strings), strings);
+  CHECK(processes.size() == (std::size_t)kProcesses);
+
+  // Every sort key, then scrolling about under each of two of them
+  static int const keys[] = {'c', 'm', 't', 'p', 'u', 'c', 'j', 'j',
+                             KEY_NPAGE, KEY_NPAGE, KEY_END, 'k', KEY_PPAGE,
+                             KEY_HOME, 'm', KEY_END, 'u', KEY_HOME, 'q'};
+  NCursesDisplay::ProcessListView view{};
+  double slowest = 0;
+  double total = 0;
+  int frames = 0;
+  int const rows = getmaxy(window) - 3;
+  for (int key : keys) {
+    auto start = std::chrono::steady_clock::now();
+    if (!NCursesDisplay::HandleKey(key, system, view, rows)) {
+      break;
+    }
+    werase(window);
+    box(window, 0, 0);
+    NCursesDisplay::DisplayProcesses(processes, system.History(),
+                                     system.SortKey(), view, window);
+    wrefresh(window);
+    view.frame_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    slowest = std::max(slowest, view.frame_ms);
+    total += view.frame_ms;
+    ++frames;
+  }
+  delwin(window);
+  endwin();
+  delscreen(screen);
+  fclose(out);
+
+  std::cout << frames << " keys over " << kProcesses
+            << " processes: average " << total / frames << " ms, slowest "
+            << slowest << " ms\n";
+  CHECK(frames == (int)(sizeof(keys) / sizeof(keys[0])) - 1);
+  CHECK(slowest < kMaxFrameMs);
+  // The last keys sorted by user and went to the top
+  CHECK(view.selected == 0);
+  CHECK(system.SortKey() == ProcessSort::kUser);
+  StringPool const& pool = system.Strings();
+  CHECK(std::is_sorted(processes.begin(), processes.end(),
+                       [&pool](Process const& a, Process const& b) {
+                         return pool.View(a.Values().user) <
+                                pool.View(b.Values().user);
+                       }));
+  return CheckResult();
+}
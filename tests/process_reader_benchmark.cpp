@@ -0,0 +1,258 @@
+// Reads every process, with a few hundred idle children added so there is
+// something to batch, with the synchronous and io_uring backends. Checks
+// that both read the same values and reports how long each takes and how
+// many system calls a read makes, counted by tracing a child with ptrace.
+// Skipped where io_uring is not available
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <vector>
+
+#include "check.h"
+#include "linux_parser.h"
+#include "process_reader.h"
+
+/**
+ * Exit status which tells ctest the test was skipped
+ */
+static const int kSkipped = 77;
+
+static const int kChildren = 500;
+static const int kRuns = 50;
+
+/**
+ * Start kChildren processes which wait to be killed
+ * @return their pids
+ */
+static std::vector<pid_t> StartChildren() {
+  std::vector<pid_t> pids;
+  for (int i = 0; i < kChildren; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      pause();
+      _exit(0);
+    }
+    if (pid > 0) {
+      pids.push_back(pid);
+    }
+  }
+  return pids;
+}
+
+static void StopChildren(std::vector<pid_t> const& pids) {
+  for (pid_t pid : pids) {
+    kill(pid, SIGKILL);
+  }
+  for (pid_t pid : pids) {
+    waitpid(pid, nullptr, 0);
+  }
+}
+
+/**
+ * Read pids with reader kRuns times
+ * @param reader
+ * @param context
+ * @param pids
+ * @param values the values of the last run
+ * @param read
+ * @return the fastest run, in seconds
+ */
+static double Benchmark(ProcessReader& reader,
+                        LinuxParser::ProcessParseContext& context,
+                        std::pmr::vector<int> const& pids,
+                        std::pmr::vector<LinuxParser::ProcessValues>& values,
+                        std::pmr::vector<char>& read) {
+  double fastest = 1e9;
+  for (int run = 0; run < kRuns; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    reader.Read(context, pids, values, read);
+    fastest = std::min(fastest, std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count());
+  }
+  return fastest;
+}
+
+/**
+ * System calls made by one read, by kind
+ */
+struct SyscallCounts {
+  long total{};
+  long io_uring_enter{};
+  long open{};
+  long read{};
+  long close{};
+};
+
+/**
+ * Add the system call numbered nr to counts
+ * @param nr
+ * @param counts
+ */
+static void Count(unsigned long nr, SyscallCounts& counts) {
+  switch (nr) {
+    case SYS_exit_group:
+      // Ends the child rather than being part of the read
+      return;
+    case SYS_io_uring_enter:
+      ++counts.io_uring_enter;
+      break;
+#ifdef SYS_open
+    case SYS_open:
+#endif
+    case SYS_openat:
+      ++counts.open;
+      break;
+    case SYS_read:
+    case SYS_pread64:
+      ++counts.read;
+      break;
+    case SYS_close:
+      ++counts.close;
+      break;
+  }
+  ++counts.total;
+}
+
+/**
+ * Count the system calls a single read of pids makes, in a child which
+ * reads them once untraced, so that the reader has set up and allocated
+ * everything it needs, and then again under ptrace. Returns false where
+ * the child cannot be traced, for example in a container which forbids it
+ * @param io_uring whether to read with the io_uring backend
+ * @param pids
+ * @param counts
+ * @return
+ */
+static bool CountSyscalls(bool io_uring, std::pmr::vector<int> const& pids,
+                          SyscallCounts& counts) {
+  pid_t child = fork();
+  if (child < 0) {
+    return false;
+  }
+  if (child == 0) {
+    ProcessReader reader;
+    if (io_uring && !reader.UseIoUring()) {
+      _exit(1);
+    }
+    LinuxParser::ProcessParseContext context;
+    std::pmr::vector<LinuxParser::ProcessValues> values;
+    std::pmr::vector<char> read;
+    reader.Read(context, pids, values, read);
+    if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) {
+      _exit(1);
+    }
+    raise(SIGSTOP);
+    reader.Read(context, pids, values, read);
+    _exit(0);
+  }
+  int status = 0;
+  if (waitpid(child, &status, 0) != child || !WIFSTOPPED(status)) {
+    return false;
+  }
+  ptrace(PTRACE_SETOPTIONS, child, nullptr,
+         PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+  while (ptrace(PTRACE_SYSCALL, child, nullptr, nullptr) == 0 &&
+         waitpid(child, &status, 0) == child && WIFSTOPPED(status)) {
+    if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+      continue;
+    }
+    __ptrace_syscall_info info{};
+    if (ptrace(PTRACE_GET_SYSCALL_INFO, child, sizeof(info), &info) > 0 &&
+        info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+      Count(info.entry.nr, counts);
+    }
+  }
+  if (!WIFEXITED(status) && !WIFSIGNALED(status)) {
+    kill(child, SIGKILL);
+    waitpid(child, &status, 0);
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Print counts, or that they could not be counted
+ * @param name
+ * @param counted
+ * @param counts
+ */
+static void Report(char const* name, bool counted,
+                   SyscallCounts const& counts) {
+  std::cout << "  " << name << ": ";
+  if (!counted) {
+    std::cout << "system calls could not be counted\n";
+    return;
+  }
+  std::cout << counts.total << " system calls, " << counts.io_uring_enter
+            << " io_uring_enter, " << counts.open << " open, " << counts.read
+            << " read, " << counts.close << " close\n";
+}
+
+int main() {
+  ProcessReader uring;
+  if (!uring.UseIoUring()) {
+    std::cout << "io_uring is not available\n";
+    return kSkipped;
+  }
+  ProcessReader sync;
+
+  std::vector<pid_t> children = StartChildren();
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::vector<int> pids(&arena);
+  LinuxParser::Pids(pids);
+
+  LinuxParser::ProcessParseContext context;
+  std::pmr::vector<LinuxParser::ProcessValues> sync_values(&arena);
+  std::pmr::vector<LinuxParser::ProcessValues> uring_values(&arena);
+  std::pmr::vector<char> sync_read(&arena);
+  std::pmr::vector<char> uring_read(&arena);
+  double sync_seconds =
+      Benchmark(sync, context, pids, sync_values, sync_read);
+  double uring_seconds =
+      Benchmark(uring, context, pids, uring_values, uring_read);
+  SyscallCounts sync_calls;
+  SyscallCounts uring_calls;
+  bool sync_counted = CountSyscalls(false, pids, sync_calls);
+  bool uring_counted = CountSyscalls(true, pids, uring_calls);
+  StopChildren(children);
+
+  std::cout << "reading " << pids.size() << " processes: sync "
+            << sync_seconds * 1e3 << " ms, io_uring " << uring_seconds * 1e3
+            << " ms\n";
+  Report("sync", sync_counted, sync_calls);
+  Report("io_uring", uring_counted, uring_calls);
+  if (sync_counted && uring_counted) {
+    // Batching is the point of the backend: it should make a few calls per
+    // batch where the synchronous one makes several per file
+    CHECK(uring_calls.io_uring_enter > 0);
+    CHECK(uring_calls.total < sync_calls.total);
+  }
+  CHECK(uring.Backend() == ReaderBackend::kIoUring);
+  CHECK(pids.size() > (std::size_t)kChildren);
+  // Children do not exit or change while they are read, so both backends
+  // see exactly the same values for them
+  std::size_t compared = 0;
+  for (std::size_t i = 0; i < pids.size(); ++i) {
+    if (std::find(children.begin(), children.end(), pids[i]) ==
+        children.end()) {
+      continue;
+    }
+    LinuxParser::ProcessValues const& a = sync_values[i];
+    LinuxParser::ProcessValues const& b = uring_values[i];
+    CHECK(sync_read[i] && uring_read[i]);
+    CHECK(a.pid == b.pid && a.user == b.user && a.command == b.command &&
+          a.vm_size == b.vm_size && a.vm_rss == b.vm_rss &&
+          a.starttime_ticks == b.starttime_ticks);
+    ++compared;
+  }
+  CHECK(compared == children.size());
+  return CheckResult();
+}
@@ -0,0 +1,120 @@
+// Induces cpu pressure with a local load generator and measures how long
+// the refresh scheduler takes to wake for it, then checks that a stretched
+// scheduler does not refresh more often however often pressure fires.
+// Skipped where pressure triggers can not be registered
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "check.h"
+#include "refresh_scheduler.h"
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+/**
+ * Exit status which tells ctest the test was skipped
+ */
+static const int kSkipped = 77;
+
+/**
+ * Longest a wait for pressure may take. A trigger fires at most once per
+ * window, so up to one window may pass before it can fire again and most
+ * of another while the stall builds up. Both double if the unprivileged
+ * 2s window was used
+ */
+static const milliseconds kMaxLatency{4 * RefreshScheduler::kWindowUs / 1000 +
+                                      500};
+
+/**
+ * Start more busy processes than there are cpus, so that some runnable
+ * task is always waiting for a cpu
+ * @return the pids of the load generators
+ */
+static std::vector<pid_t> StartLoad() {
+  std::vector<pid_t> pids;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (long i = 0; i < 2 * cpus; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      // volatile so the loop is not optimized away
+      for (volatile unsigned long spin = 0;; ++spin) {
+      }
+    }
+    if (pid > 0) {
+      pids.push_back(pid);
+    }
+  }
+  return pids;
+}
+
+static void StopLoad(std::vector<pid_t> const& pids) {
+  for (pid_t pid : pids) {
+    kill(pid, SIGKILL);
+  }
+  for (pid_t pid : pids) {
+    waitpid(pid, nullptr, 0);
+  }
+}
+
+int main() {
+  RefreshScheduler scheduler(milliseconds(100), milliseconds(5000));
+  if (!scheduler.Arm()) {
+    std::cout << "pressure triggers are not available\n";
+    return kSkipped;
+  }
+
+  // Let any pressure from before the test drain, so that the wake measured
+  // is the one the load causes
+  int calm = 0;
+  for (int wait = 0; wait < 50 && calm < 2; ++wait) {
+    calm = scheduler.Wait() == RefreshScheduler::Wake::kTimeout ? calm + 1 : 0;
+  }
+  CHECK(calm == 2);
+
+  std::vector<pid_t> load = StartLoad();
+  auto start = steady_clock::now();
+  RefreshScheduler::Wake wake{RefreshScheduler::Wake::kTimeout};
+  while (wake != RefreshScheduler::Wake::kPressure &&
+         steady_clock::now() - start < 5 * kMaxLatency) {
+    wake = scheduler.Wait();
+  }
+  auto latency = std::chrono::duration_cast<milliseconds>(
+      steady_clock::now() - start);
+
+  // Triggers keep firing about once a window while the load runs. Stretched
+  // past the window, refreshes must still be at least the stretched fast
+  // interval apart
+  const int stretch = 3 * RefreshScheduler::kWindowUs / 1000 / 100;
+  scheduler.Stretch(stretch);
+  milliseconds shortest{milliseconds::max()};
+  int pressure_wakes = 0;
+  auto previous = steady_clock::now();
+  for (int refresh = 0; refresh < 3; ++refresh) {
+    pressure_wakes += scheduler.Wait() == RefreshScheduler::Wake::kPressure;
+    auto now = steady_clock::now();
+    shortest = std::min(
+        shortest, std::chrono::duration_cast<milliseconds>(now - previous));
+    previous = now;
+  }
+  scheduler.Stretch(1);
+  StopLoad(load);
+
+  std::cout << "pressure from " << load.size()
+            << " busy processes detected after " << latency.count()
+            << " ms, next refresh in " << scheduler.Interval().count()
+            << " ms\n";
+  CHECK(wake == RefreshScheduler::Wake::kPressure);
+  CHECK(latency <= kMaxLatency);
+  std::cout << pressure_wakes << " of 3 stretched refreshes woken by pressure,"
+            << " at least " << shortest.count() << " ms apart\n";
+  CHECK(pressure_wakes > 0);
+  CHECK(shortest >= milliseconds(100 * stretch) - milliseconds(10));
+  CHECK(scheduler.Interval() == milliseconds(100));
+  return CheckResult();
+}
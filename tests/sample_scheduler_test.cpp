@@ -0,0 +1,56 @@
+// Checks that a quiet process in the slowest tier is read in full on the
+// tick after its probe shows it has become busy, rather than waiting for
+// its tier's interval
+
+#include "check.h"
+#include "sample_scheduler.h"
+
+int main() {
+  SampleScheduler scheduler(0.01f);
+  SampleState state;
+  int const pid = 1234;
+  scheduler.BeginTick();
+  scheduler.Born(state);
+
+  // Quiet until it reaches the slowest tier, probing whenever not due
+  int ticks = 0;
+  while (state.tier + 1u < SampleScheduler::kTiers && ticks < 1000) {
+    scheduler.BeginTick();
+    ++ticks;
+    if (scheduler.Due(state, pid, 0.0f)) {
+      scheduler.Sampled(state, pid, 0.0f);
+    } else {
+      CHECK(scheduler.Probing());
+      scheduler.Probed(state, 0.0f);
+    }
+  }
+  CHECK(state.tier + 1u == SampleScheduler::kTiers);
+
+  // Still quiet on the next tick, then busy on the one after
+  scheduler.BeginTick();
+  if (scheduler.Due(state, pid, 0.0f)) {
+    scheduler.Sampled(state, pid, 0.0f);
+    scheduler.BeginTick();
+  }
+  CHECK(!scheduler.Due(state, pid, 0.0f));
+  scheduler.Probed(state, 0.5f);
+  CHECK(scheduler.Probes() == 1);
+
+  scheduler.BeginTick();
+  CHECK(scheduler.Due(state, pid, 0.5f));
+  scheduler.Sampled(state, pid, 0.5f);
+  CHECK(state.tier == 0);
+
+  // Probes under the floor leave the tier alone
+  SampleState quiet;
+  quiet.tier = 2;
+  scheduler.Probed(quiet, 0.005f);
+  CHECK(quiet.tier == 2);
+
+  // A cutoff sweeps quiet processes instead of probing them
+  scheduler.Cutoff(0.1f);
+  CHECK(!scheduler.Probing());
+  scheduler.Cutoff(-1.0f);
+  CHECK(scheduler.Probing());
+  return CheckResult();
+}